@@ -3,85 +3,122 @@
 #include <clicknet/tcp.h>
 #include <clicknet/udp.h>
 #include <click/error.hh>
-#include "../clickityclack/external/freebsdbob.hh"
 #include "../clickityclack/lib/checksumfixup.hh"
 #include "lib/tcpopt.hh"
-#include "lib/p4crc32.hh"
-#include "lib/dumper.hh"
+#include "lib/handlerargs.hh"
 
 CLICK_DECLS
 
 using namespace Beamer;
 using namespace ClickityClack;
 
-#define CLICK_BEAMER_HASHFN_BOB 0
-#define CLICK_BEAMER_HASHFN_CRC 1
-
-#ifndef CLICK_BEAMER_HASHFN
-#define CLICK_BEAMER_HASHFN CLICK_BEAMER_HASHFN_CRC
-#endif
-
-static inline uint32_t beamerHash(const click_ip *ipHeader, const click_tcp *tcpHeader)
+BeamerMux::BeamerMux()
+	: rings(NULL), adopting(false), transitionWindow(0), stageFunction(NULL)
 {
-#if CLICK_BEAMER_HASHFN == CLICK_BEAMER_HASHFN_BOB
-	return freeBSDBob(ipHeader->ip_src.s_addr, tcpHeader->th_sport, tcpHeader->th_dport);
-#elif CLICK_BEAMER_HASHFN == CLICK_BEAMER_HASHFN_CRC
-	struct HashTouple touple = { ipHeader->ip_src.s_addr, tcpHeader->th_sport };
-	return p4_crc32_6((char *)&touple);
-#else
-#error Invalid CLICK_BEAMER_HASHFN
-#endif
+	stats = new PathStats[click_max_cpu_ids()](); assert(stats);
 }
 
-static inline uint32_t beamerHash(const click_ip *ipHeader, const click_udp *udpHeader)
+BeamerMux::~BeamerMux()
 {
-#if CLICK_BEAMER_HASHFN == CLICK_BEAMER_HASHFN_BOB
-	return freeBSDBob(ipHeader->ip_src.s_addr, udpHeader->uh_sport, udpHeader->uh_dport);
-#elif CLICK_BEAMER_HASHFN == CLICK_BEAMER_HASHFN_CRC
-	struct HashTouple touple = { ipHeader->ip_src.s_addr, udpHeader->uh_sport };
-	return p4_crc32_6((char *)&touple);
-#else
-#error Invalid CLICK_BEAMER_HASHFN
-#endif
+	/* a dump may still be reading it */
+	dumpJob.join();
+	delete rings;
+	delete[] stats;
 }
 
-BeamerMux::BeamerMux()
-	: hashZkClient("/beamer/mux_ring/", &bucketMap), idZkClient("/beamer/id/", &idMap) {}
-
-BeamerMux::~BeamerMux() {}
-
-static const int RESERVED_PORT_COUNT = 1024;
+/* never falls back on age */
+static const uint32_t NO_TRANSITION_WINDOW = 0x7fffffff;
 
 int BeamerMux::configure(Vector<String> &conf, ErrorHandler *errh)
 {
 	String zkConnectString;
 	int ringSize = 1;
+	Vector<String> services;
+	Vector<IPAddress> vips;
+	int zkWindow = 16;
+	int zkReplayThreads = 1;
+	uint32_t window = 0;
+	String hash = "CRC";
+	String reduce = "MODULO";
+	String encap = "GG";
+	int guePort = GUE_DEFAULT_PORT;
+	int retaSize = 128;
+	String snapshot;
+	String idSnapshot;
 	
 	if (Args(conf, this, errh)
-		.read("ZK",        StringArg(),                     zkConnectString)
-		.read("RING_SIZE", BoundedIntArg(0, (int)0x800000), ringSize)
+		.read("ZK",                StringArg(),                       zkConnectString)
+		.read("RING_SIZE",         BoundedIntArg(0, (int)0x40000000), ringSize)
+		.read_all("SERVICE",       StringArg(),                       services)
+		.read_all("VIP",           IPAddressArg(),                    vips)
+		.read("TRANSITION_WINDOW", SecondsArg(),                      window)
+		.read("HASH",              WordArg(),                         hash)
+		.read("REDUCE",            WordArg(),                         reduce)
+		.read("ENCAP",             WordArg(),                         encap)
+		.read("GUE_PORT",          BoundedIntArg(1, 65535),           guePort)
+		.read_all("RSS_CPU",       IntArg(),                          rssCPUs)
+		.read("RSS_RETA_SIZE",     IntArg(),                          retaSize)
+		.read("ZK_WINDOW",         BoundedIntArg(1, 1024),            zkWindow)
+		.read("ZK_REPLAY_THREADS", BoundedIntArg(1, 64),              zkReplayThreads)
+		.read("SNAPSHOT",          FilenameArg(),                     snapshot)
+		.read("ID_SNAPSHOT",       FilenameArg(),                     idSnapshot)
 		.complete() < 0)
 	{
 		return -1;
 	}
-
-	if (zkConnectString.length() != 0)
+	
+	/* 0: keep daisy chaining for as long as a bucket remembers its previous DIP */
+	if (window > NO_TRANSITION_WINDOW)
+		return errh->error("Bad TRANSITION_WINDOW");
+	transitionWindow = window ? window : NO_TRANSITION_WINDOW;
+	
+	if (!parseHashKind(hash, &policies.hash))
+		return errh->error("Bad HASH: expected CRC, BOB or TOEPLITZ");
+	if (!parseReductionKind(reduce, &policies.reduction))
+		return errh->error("Bad REDUCE: expected MODULO, MASK or MULTIPLY_SHIFT");
+	if (!parseEncapKind(encap, &policies.encap))
+		return errh->error("Bad ENCAP: expected IPIP, GG or GUE");
+	encapper.setGUEPort(guePort);
+	stageFunction = pickPolicies<StagePicker>(policies);
+	
+	int sliceBits = rssSliceBits(policies, rssCPUs, retaSize, errh);
+	if (sliceBits < 0)
+		return -1;
+	
+	rings = new RingTable(RingTable::describe(zkConnectString, services, vips, ringSize)); assert(rings);
+	rings->setFetchWindow(zkWindow);
+	rings->setReplayThreads(zkReplayThreads);
+	if (sliceBits)
+		rings->setSlicing(sliceBits, rssCPUs);
+	
+	BeamerMux *old = (BeamerMux *)(hotswap_element() ? hotswap_element()->cast("BeamerMux") : NULL);
+	
+	/* no point in connecting and downloading what the old instance already has */
+	adopting = old && old->rings && old->rings->getSpec() == rings->getSpec();
+	if (!adopting)
 	{
-		if (hashZkClient.connect(zkConnectString) < 0)
-			return errh->error("Error connectiong to ZooKeeper: %s", strerror(errno));
-		if (idZkClient.connect(zkConnectString) < 0)
-			return errh->error("Error connectiong to ZooKeeper: %s", strerror(errno));
-		vip = hashZkClient.getInt32("/beamer/config/vip", false);
-		bucketMap.init(hashZkClient.getInt32("/beamer/config/ring_size", false));
+		if (rings->setUp(zkConnectString, services, vips, ringSize, errh) < 0)
+			return -1;
+		
+		if (snapshot.length() != 0 || idSnapshot.length() != 0)
+		{
+			if (rings->size() > 1)
+				return errh->error("SNAPSHOT and ID_SNAPSHOT need a single service");
+			rings->get(0)->loadSnapshots(snapshot, idSnapshot, errh);
+		}
 	}
-	else
+	
+	/* the rings come with their sizes; the old instance's if we're taking them over */
+	RingTable *sized = adopting ? old->rings : rings;
+	
+	for (int i = 0; i < sized->size(); i++)
 	{
-		vip = 0;
-		bucketMap.init(ringSize);
+		if (!reductionFits(policies.reduction, sized->get(i)->bucketMap.size()))
+			return errh->error("REDUCE %s doesn't fit ring size %lu", reduce.c_str(), sized->get(i)->bucketMap.size());
+		if (sliceBits && sized->get(i)->bucketMap.slices() != (1UL << sliceBits))
+			return errh->error("RSS_RETA_SIZE %d needs rings of at least that many buckets", retaSize);
 	}
 	
-	idMap.init(0x10000);
-	
 	return 0;
 }
 
@@ -89,114 +126,196 @@ int BeamerMux::initialize(ErrorHandler *errh)
 {
 	(void)errh;
 	
-	if (hashZkClient.isLive())
-		hashZkClient.sync();
-	
-	if (idZkClient.isLive())
-		idZkClient.sync();
+	if (!adopting)
+		rings->sync();
 	
 	return 0;
 }
 
-Packet *BeamerMux::handleTCP(Packet *p)
-{
-	const click_ip *ipHeader = p->ip_header();
-	const click_tcp *tcpHeader = p->tcp_header();
-	uint32_t dip;
-	uint32_t prevDip = 0;
-	uint32_t ts;
-	uint32_t gen = htonl(hashZkClient.getGen());
-	
-	if (ntohs(tcpHeader->th_dport) < RESERVED_PORT_COUNT)
-	{
-		uint32_t hash = beamerHash(ipHeader, tcpHeader);
-		DIPHistoryEntry entry = bucketMap.get(hash);
-		dip = entry.current;
-		prevDip = entry.prev;
-		ts = entry.timestamp;
-		
-		return ggEncapper.encapsulate(p, vip.addr(), dip, prevDip, ts, gen);
-	}
-	else
-	{
-		uint16_t id = ntohs(tcpHeader->th_dport);
-		dip = idMap.get(id);
-		
-		return ipipEncapper.encapsulate(p, vip.addr(), dip);
-	}
-}
-
-Packet *BeamerMux::handleUDP(Packet *p)
+void BeamerMux::take_state(Element *old, ErrorHandler *errh)
 {
-	uint32_t hash = beamerHash(p->ip_header(), p->udp_header());
-	uint32_t dip = bucketMap.get(hash).current;
+	BeamerMux *oldMux = (BeamerMux *)old->cast("BeamerMux");
+	
+	(void)errh;
 	
-	return ipipEncapper.encapsulate(p, vip.addr(), dip);
+	if (!adopting || !oldMux)
+		return;
+	
+	/* the new settings apply to the adopted clients from here on */
+	oldMux->rings->retune(rings);
+	
+	RingTable *tmp = rings;
+	rings = oldMux->rings;
+	oldMux->rings = tmp;
 }
 
-#if HAVE_BATCH
-PacketBatch *BeamerMux::simple_action_batch(PacketBatch *head)
+/*
+ * Every stage gets split by class once (see classifyStage()); packets to
+ * other VIPs are on no list and pass through as is. Each class then has
+ * loops of its own; packets are updated in place, so the stage keeps its
+ * order.
+ */
+template <typename HASH, typename REDUCTION, typename ENCAP>
+void BeamerMux::processStage(Packet **pkts, int count, unsigned int cpuID, uint32_t wallNow)
 {
-	Packet *current = head;
-	Packet *last = head;
+	RingState *stageRings[BATCH_STAGE]; /* the stage's VIPs, each with its views loaded once */
+	RingMap::View ringViews[BATCH_STAGE];
+	PlainDIPMap::View idViews[BATCH_STAGE];
+	int stageRingCount = 0;
+	uint8_t pktRings[BATCH_STAGE]; /* into stageRings, or NO_RING */
+	StageClasses classes;
+	HashTouple touples[BATCH_STAGE];
+	uint16_t dports[BATCH_STAGE];
+	uint32_t hashes[BATCH_STAGE];
+	unsigned long buckets[BATCH_STAGE];
+	uint8_t ringSlots[BATCH_STAGE];
+	DIPHistoryEntry entries[BATCH_STAGE];
+	uint8_t daisy[BATCH_STAGE];
+	uint16_t ids[BATCH_STAGE];
+	uint32_t idHashes[BATCH_STAGE];
+	int ggCount = 0;
 	
-	while (current != NULL)
+	/* stage 0: which VIP, if there's more than one; a ring's views are loaded when it first shows up */
+	if (rings->size() == 1)
 	{
-		/* do stuff */
-		uint8_t proto = current->ip_header()->ip_p;
-		Packet *result = NULL;
-		
-		switch (proto)
+		stageRings[0] = rings->get(0);
+		ringViews[0] = stageRings[0]->bucketMap.view();
+		idViews[0] = stageRings[0]->idMap.view();
+		stageRingCount = 1;
+		for (int i = 0; i < count; i++)
+			pktRings[i] = 0;
+	}
+	else
+	{
+		for (int i = 0; i < count; i++)
 		{
-		case IPPROTO_TCP:
-			result = handleTCP(current);
-			break;
+			RingState *ring = ringFor(pkts[i]->ip_header()->ip_dst.s_addr);
+			int slot = stageRingCount - 1;
 			
-		case IPPROTO_UDP:
-			result = handleUDP(current);
-			break;
+			pktRings[i] = NO_RING;
+			if (!ring)
+				continue;
 			
-		default:
-			result = current;
-			break;
+			/* packets to the same VIP tend to come in runs */
+			while (slot >= 0 && stageRings[slot] != ring)
+				slot--;
+			if (slot < 0)
+			{
+				slot = stageRingCount++;
+				stageRings[slot] = ring;
+				ringViews[slot] = ring->bucketMap.view();
+				idViews[slot] = ring->idMap.view();
+			}
+			pktRings[i] = slot;
 		}
+	}
+	
+	/* stage 1: split by class */
+	classifyStage(pkts, count, pktRings, &classes);
+	
+	const uint8_t *ringPkts = classes.ringPkts;
+	const uint8_t *idPkts = classes.idPkts;
+	int tcpCount = classes.tcpCount;
+	int udpCount = classes.udpCount;
+	int idCount = classes.idCount;
+	int ringCount = classes.ringCount();
+	
+	/* stage 2: hash and prefetch, so that the map misses overlap */
+	for (int j = 0; j < ringCount; j++)
+	{
+		int i = ringPkts[j];
+		const uint16_t *ports = reinterpret_cast<const uint16_t *>(pkts[i]->transport_header());
 		
-		if (current == head)
+		touples[j].src_ip = pkts[i]->ip_header()->ip_src.s_addr;
+		touples[j].src_port = ports[0];
+		dports[j] = ports[1];
+		ringSlots[j] = pktRings[i];
+	}
+	HASH::hashBatch(touples, dports, hashes, ringCount);
+	for (int j = 0; j < ringCount; j++)
+	{
+		RingMap *map = &stageRings[ringSlots[j]]->bucketMap;
+		
+		buckets[j] = REDUCTION::bucket(hashes[j], map->size());
+		map->prefetchAt(ringViews[ringSlots[j]], buckets[j]);
+	}
+	for (int k = 0; k < idCount; k++)
+	{
+		int i = idPkts[k];
+		const click_tcp *tcpHeader = pkts[i]->tcp_header();
+		
+		ids[k] = ntohs(tcpHeader->th_dport);
+		idHashes[k] = Encapper::entropy(pkts[i]->ip_header()->ip_src.s_addr, tcpHeader->th_sport);
+		stageRings[pktRings[i]]->idMap.prefetch(idViews[pktRings[i]], ids[k]);
+	}
+	
+	/* stage 3: look up, then decide which TCP buckets still need the metadata */
+	for (int j = 0; j < ringCount; j++)
+		entries[j] = stageRings[ringSlots[j]]->bucketMap.at(ringViews[ringSlots[j]], buckets[j]);
+	if (ENCAP::METADATA)
+	{
+		for (int j = 0; j < tcpCount; j++)
 		{
-			head = PacketBatch::start_head(result);
-			head->set_next(current->next());
+			daisy[j] = entries[j].inTransition(wallNow, transitionWindow);
+			ggCount += daisy[j];
 		}
+	}
+	
+	/* stage 4: encapsulate, a class at a time */
+	for (int j = 0; j < tcpCount; j++)
+	{
+		int i = ringPkts[j];
+		RingState *ring = stageRings[pktRings[i]];
+		
+		if (ENCAP::METADATA && daisy[j])
+			pkts[i] = ENCAP::encapsulate(&encapper, pkts[i], ring->vip.addr(), entries[j].current, entries[j].prev, entries[j].timestamp, htonl(ring->hashZkClient.getGen()), hashes[j]);
 		else
-		{
-			last->set_next(result);
-			result->set_next(current->next());
-		}
+			pkts[i] = ENCAP::encapsulatePlain(&encapper, pkts[i], ring->vip.addr(), entries[j].current, hashes[j]);
+	}
+	for (int j = tcpCount; j < ringCount; j++)
+	{
+		int i = ringPkts[j];
 		
-		last = result;
-		current = result->next();
+		pkts[i] = ENCAP::encapsulatePlain(&encapper, pkts[i], stageRings[pktRings[i]]->vip.addr(), entries[j].current, hashes[j]);
 	}
+	for (int k = 0; k < idCount; k++)
+	{
+		int i = idPkts[k];
+		RingState *ring = stageRings[pktRings[i]];
+		
+		pkts[i] = ENCAP::encapsulatePlain(&encapper, pkts[i], ring->vip.addr(), ring->idMap.get(idViews[pktRings[i]], ids[k]), idHashes[k]);
+	}
+	
+	stats[cpuID].gg += ggCount;
+	stats[cpuID].elided += tcpCount - ggCount;
+	stats[cpuID].ipip += udpCount + idCount;
+}
+
+#if HAVE_BATCH
+PacketBatch *BeamerMux::simple_action_batch(PacketBatch *head)
+{
+	unsigned int cpuID = click_current_cpu_id();
+	StageCall call = { this, stageFunction, cpuID, (uint32_t)time(NULL) };
+	
+	/* no view outlives the batch */
+	rings->readers()->enter(cpuID);
+	head = runStages(head, call);
+	rings->readers()->exit(cpuID);
+	
 	return head;
 }
 #endif
 
 Packet *BeamerMux::simple_action(Packet *p)
 {
-	uint8_t proto = p->ip_header()->ip_p;
+	unsigned int cpuID = click_current_cpu_id();
 	
-	switch (proto)
-	{
-	case IPPROTO_TCP:
-		return handleTCP(p);
-		
-	case IPPROTO_UDP:
-		return handleUDP(p);
-		
-	default:
-		return p;
-	}
+	/* a stage of one */
+	rings->readers()->enter(cpuID);
+	(this->*stageFunction)(&p, 1, cpuID, time(NULL));
+	rings->readers()->exit(cpuID);
 	
-	p->kill();
-	return NULL;
+	return p;
 }
 
 enum
@@ -207,30 +326,13 @@ enum
 	
 	/* read */
 	H_GEN,
+	H_DUMP_STATUS,
+	H_GG_PACKETS,
+	H_ELIDED_PACKETS,
+	H_IPIP_PACKETS,
+	H_RSS,
 };
 
-static void tokenize(const String &str, int startIndex, Vector<String> *vec)
-{
-	if (startIndex == str.length())
-		return;
-	
-	int spaceIndex = str.find_left(' ', startIndex);
-	
-	if (spaceIndex == -1) /* no spaces */
-	{
-		vec->push_back(str.substring(startIndex, str.length() - startIndex));
-	}
-	else if (spaceIndex == startIndex) /* starts with space */
-	{
-		tokenize(str, startIndex + 1, vec);
-	}
-	else /* got some space */
-	{
-		vec->push_back(str.substring(startIndex, spaceIndex - startIndex));
-		tokenize(str, spaceIndex + 1, vec);
-	}
-}
-
 int BeamerMux::writeHandler(const String &conf, Element *e, void *thunk, ErrorHandler *errh)
 {
 	BeamerMux *me = (BeamerMux *)e;
@@ -239,40 +341,56 @@ int BeamerMux::writeHandler(const String &conf, Element *e, void *thunk, ErrorHa
 	IPAddress dip;
 	Vector<String> tokens;
 	
-	DIPHistoryLogHeader ts;
+	String hashPath = "hash_dump.raw";
+	String idPath = "id_dump.raw";
 	
 	int err;
 	
 	switch ((intptr_t)thunk)
 	{
 	case H_ASSIGN:
-		tokenize(conf, 0, &tokens);
-		if (tokens.size() < 2)
-			return errh->error("expected 2+ arguments, got %d", tokens.size());
+	{
+		RingState *ring = me->rings->get(0);
+		int first = 0;
 		
-		if (!IPAddressArg().parse(tokens[0], dip))
-			return errh->error("bad DIP");
+		tokenize(conf, 0, &tokens);
 		
-		for (int i = 1; i < tokens.size(); i++)
+		/* with several VIPs, the VIP goes first */
+		if (me->rings->size() > 1)
 		{
-			int index;
+			IPAddress vip;
 			
-			if (!IntArg().parse(tokens[i], index))
-				return errh->error("bad index %s", tokens[i].c_str());
-			buckets.push_back(index);
+			if (!tokens.size() || !IPAddressArg().parse(tokens[0], vip) || !(ring = me->ringFor(vip.addr())))
+				return errh->error("bad VIP");
+			first = 1;
 		}
 		
-		ts.timestamp = time(NULL);
-		for (int i = 0; i < buckets.size(); i++)
-			me->bucketMap.updateEntry(buckets[i], dip.addr(), ts);
-		
+		if (parseAssignment(tokens, first, ring->bucketMap.size(), &dip, &buckets, errh) < 0)
+			return -1;
+		if ((err = ring->assign(dip.addr(), buckets)) < 0)
+			return errh->error("%s", strerror(-err));
 		break;
-		
+	}
+	
 	case H_DUMP:
-		err = Dumper::dump<Beamer::ZKClient<Beamer::DIPHistoryMap> >(&me->hashZkClient, "hash_dump.raw");
-		if (err < 0)
-			return errh->error("error dumping: %d (%s)", -err, strerror(-err));
-		err = Dumper::dump<Beamer::ZKClient<Beamer::PlainDIPMap> >(&me->idZkClient, "id_dump.raw");
+		tokenize(conf, 0, &tokens);
+		if (tokens.size() > 2)
+			return errh->error("expected 0-2 arguments, got %d", tokens.size());
+		if (tokens.size() > 0)
+			hashPath = tokens[0];
+		if (tokens.size() > 1)
+			idPath = tokens[1];
+		
+		if (me->rings->size() > 1)
+			return errh->error("dump needs a single service");
+		
+		/* the dump runs in the background; poll dump_status */
+		if (me->dumpJob.busy())
+			return errh->error("dump already in progress");
+		me->dumpJob.clear();
+		me->dumpJob.add(&me->rings->get(0)->hashZkClient, hashPath);
+		me->dumpJob.add(&me->rings->get(0)->idZkClient, idPath);
+		err = me->dumpJob.start();
 		if (err < 0)
 			return errh->error("error dumping: %d (%s)", -err, strerror(-err));
 		break;
@@ -291,8 +409,43 @@ String BeamerMux::readHandler(Element *e, void *thunk)
 	switch ((intptr_t)thunk)
 	{
 	case H_GEN:
-		return String() + me->hashZkClient.getGen();
+	{
+		if (me->rings->size() == 1)
+			return String() + me->rings->get(0)->hashZkClient.getGen();
 		
+		/* one "VIP GEN" line per service */
+		String ret;
+		
+		for (int i = 0; i < me->rings->size(); i++)
+			ret += me->rings->get(i)->vip.unparse() + " " + String(me->rings->get(i)->hashZkClient.getGen()) + "\n";
+		return ret;
+	}
+	
+	case H_DUMP_STATUS:
+		return me->dumpJob.status();
+	
+	case H_GG_PACKETS:
+	case H_ELIDED_PACKETS:
+	case H_IPIP_PACKETS:
+	{
+		uint64_t total = 0;
+		
+		for (int i = 0; i < click_max_cpu_ids(); i++)
+		{
+			if ((intptr_t)thunk == H_GG_PACKETS)
+				total += me->stats[i].gg;
+			else if ((intptr_t)thunk == H_ELIDED_PACKETS)
+				total += me->stats[i].elided;
+			else
+				total += me->stats[i].ipip;
+		}
+		return String(total);
+	}
+	
+	/* for ethtool -X */
+	case H_RSS:
+		return me->rssCPUs.size() ? toeplitzRSSSettings(me->rssCPUs.size()) : String();
+	
 	default:
 		return "<error: bad operation>";
 	}
@@ -305,7 +458,12 @@ void BeamerMux::add_handlers()
 	add_write_handler("assign", &writeHandler, H_ASSIGN);
 	add_write_handler("dump",   &writeHandler, H_DUMP);
 	
-	add_read_handler("gen", &readHandler, H_GEN);
+	add_read_handler("gen",            &readHandler, H_GEN);
+	add_read_handler("dump_status",    &readHandler, H_DUMP_STATUS);
+	add_read_handler("gg_packets",     &readHandler, H_GG_PACKETS);
+	add_read_handler("elided_packets", &readHandler, H_ELIDED_PACKETS);
+	add_read_handler("ipip_packets",   &readHandler, H_IPIP_PACKETS);
+	add_read_handler("rss",            &readHandler, H_RSS);
 }
 
 CLICK_ENDDECLS
@@ -314,6 +472,7 @@ EXPORT_ELEMENT(BeamerMux)
 
 ELEMENT_REQUIRES(Beamer_ZKClient)
 ELEMENT_REQUIRES(Beamer_TCPOpt)
-ELEMENT_REQUIRES(ClickityClack_IPIPEncapper)
 ELEMENT_REQUIRES(Beamer_GGEncapper)
+ELEMENT_REQUIRES(Beamer_GUEEncapper)
 ELEMENT_REQUIRES(Beamer_P4CRC32)
+ELEMENT_REQUIRES(Beamer_Toeplitz)
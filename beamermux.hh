@@ -9,8 +9,10 @@
 #endif
 #include "lib/dipmap.hh"
 #include "lib/zkclient.hh"
-#include "lib/ggencapper.hh"
-#include "../clickityclack/lib/ipipencapper.hh"
+#include "lib/dumper.hh"
+#include "lib/ringtable.hh"
+#include "lib/muxpolicy.hh"
+#include "lib/batchstage.hh"
 
 CLICK_DECLS
 
@@ -35,6 +37,8 @@ public:
 	
 	int initialize(ErrorHandler *errh);
 	
+	void take_state(Element *old, ErrorHandler *errh);
+	
 	Packet *simple_action(Packet *p);
 	
 #if HAVE_BATCH
@@ -48,19 +52,77 @@ public:
 	void add_handlers();
 	
 private:
-	ClickityClack::IPIPEncapper ipipEncapper;
-	Beamer::GGEncapper ggEncapper;
-	
-	IPAddress vip;
-	
-	Beamer::DIPHistoryMap bucketMap;
-	Beamer::ZKClient<Beamer::DIPHistoryMap> hashZkClient;
-	
-	Beamer::PlainDIPMap idMap;
-	Beamer::ZKClient<Beamer::PlainDIPMap> idZkClient;
-	
-	Packet *handleTCP(Packet *p);
-	Packet *handleUDP(Packet *p);
+	Beamer::Encapper encapper;
+	
+	Beamer::MuxPolicies policies;
+	
+	/* one ring per VIP */
+	Beamer::RingTable *rings;
+	
+	/* hotswapping from an instance on the same rings: take_state() hands them over */
+	bool adopting;
+	
+	/* the ring for packets to dst, or NULL if it isn't one of ours */
+	Beamer::RingState *ringFor(uint32_t dst) const
+	{
+		if (rings->size() == 1)
+			return rings->get(0);
+		
+		int index = rings->find(dst);
+		
+		return index >= 0 ? rings->get(index) : NULL;
+	}
+	
+	Beamer::DumpJob dumpJob;
+	
+	/* the CPU serving each queue RSS spreads over with our key; empty without RSS */
+	Vector<int> rssCPUs;
+	
+	/* buckets that changed DIPs longer than transitionWindow seconds ago get plain IPIP */
+	uint32_t transitionWindow;
+	
+	/* packets per encapsulation, per CPU */
+	struct PathStats
+	{
+		uint64_t gg;
+		uint64_t elided; /* ring TCP sent as IPIP */
+		uint64_t ipip;
+	} __attribute__((aligned(64)));
+	
+	PathStats *stats;
+	
+	template <typename HASH, typename REDUCTION, typename ENCAP>
+	void processStage(Packet **pkts, int count, unsigned int cpuID, uint32_t wallNow);
+	
+	typedef void (BeamerMux::*StageFunction)(Packet **pkts, int count, unsigned int cpuID, uint32_t wallNow);
+	
+	/* processStage() for the configured policies */
+	StageFunction stageFunction;
+	
+	/* a stage, as runStages() calls it */
+	struct StageCall
+	{
+		BeamerMux *mux;
+		StageFunction function;
+		unsigned int cpuID;
+		uint32_t wallNow;
+		
+		void operator()(Packet **pkts, int count) const
+		{
+			(mux->*function)(pkts, count, cpuID, wallNow);
+		}
+	};
+	
+	struct StagePicker
+	{
+		typedef StageFunction Result;
+		
+		template <typename HASH, typename REDUCTION, typename ENCAP>
+		static Result pick()
+		{
+			return &BeamerMux::processStage<HASH, REDUCTION, ENCAP>;
+		}
+	};
 };
 
 CLICK_ENDDECLS
@@ -0,0 +1,109 @@
+/*
+ * Checks p4_crc32_6_batch() against p4_crc32_6() and times both, in
+ * stages of 32 touples like the muxes hash them. Not an element; build it
+ * against a configured Click tree with something like
+ *
+ *   g++ -O2 -std=gnu++11 -DCLICK_USERLEVEL -I$CLICK/include \
+ *       bench/p4crc32bench.cc lib/p4crc32.cc -o p4crc32bench
+ *
+ * and run it as p4crc32bench [TOUPLES [ROUNDS]].
+ */
+
+#include <click/config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <time.h>
+#include "../lib/p4crc32.hh"
+
+using namespace Beamer;
+
+/* BATCH_STAGE */
+static const int STAGE = 32;
+
+static uint64_t nanoseconds()
+{
+	struct timespec ts;
+	
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* xorshift32; the same touples every run */
+static uint32_t nextRandom(uint32_t *state)
+{
+	uint32_t x = *state;
+	
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+int main(int argc, char **argv)
+{
+	int count = argc > 1 ? atoi(argv[1]) : 1 << 20;
+	int rounds = argc > 2 ? atoi(argv[2]) : 20;
+	uint32_t seed = 0x9e3779b9;
+	volatile uint32_t sink = 0;
+	
+	if (count <= 0 || rounds <= 0)
+	{
+		fprintf(stderr, "usage: %s [TOUPLES [ROUNDS]]\n", argv[0]);
+		return 1;
+	}
+	
+	HashTouple *touples = new HashTouple[count]; assert(touples);
+	uint32_t *scalar = new uint32_t[count]; assert(scalar);
+	uint32_t *batch = new uint32_t[count]; assert(batch);
+	
+	for (int i = 0; i < count; i++)
+	{
+		touples[i].src_ip = nextRandom(&seed);
+		touples[i].src_port = nextRandom(&seed);
+	}
+	
+	/* every stage size, so the tails past the vector path get checked too */
+	for (int i = 0; i < count; i++)
+		scalar[i] = p4_crc32_6(reinterpret_cast<const char *>(&touples[i]));
+	for (int off = 0, len = 1; off < count; off += len, len = len % STAGE + 1)
+		p4_crc32_6_batch(touples + off, batch + off, off + len <= count ? len : count - off);
+	for (int i = 0; i < count; i++)
+	{
+		if (batch[i] != scalar[i])
+		{
+			fprintf(stderr, "touple %d: p4_crc32_6_batch %08x, p4_crc32_6 %08x\n", i, batch[i], scalar[i]);
+			return 1;
+		}
+	}
+	
+	uint64_t start = nanoseconds();
+	for (int r = 0; r < rounds; r++)
+	{
+		for (int i = 0; i < count; i++)
+			scalar[i] = p4_crc32_6(reinterpret_cast<const char *>(&touples[i]));
+		sink ^= scalar[r % count];
+	}
+	uint64_t scalarTime = nanoseconds() - start;
+	
+	start = nanoseconds();
+	for (int r = 0; r < rounds; r++)
+	{
+		for (int off = 0; off < count; off += STAGE)
+			p4_crc32_6_batch(touples + off, batch + off, off + STAGE <= count ? STAGE : count - off);
+		sink ^= batch[r % count];
+	}
+	uint64_t batchTime = nanoseconds() - start;
+	
+	double total = (double)count * rounds;
+	
+	printf("%d touples x %d rounds, all equal\n", count, rounds);
+	printf("p4_crc32_6:       %6.2f ns/touple\n", scalarTime / total);
+	printf("p4_crc32_6_batch: %6.2f ns/touple (%.2fx)\n", batchTime / total, (double)scalarTime / batchTime);
+	
+	delete[] touples;
+	delete[] scalar;
+	delete[] batch;
+	return 0;
+}
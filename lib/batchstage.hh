@@ -0,0 +1,136 @@
+#ifndef CLICK_BEAMER_BATCHSTAGE_HH
+#define CLICK_BEAMER_BATCHSTAGE_HH
+
+#include <click/config.h>
+#include <click/packet.hh>
+#if HAVE_BATCH
+#include <click/batchelement.hh>
+#endif
+#include <clicknet/ip.h>
+
+CLICK_DECLS
+
+namespace Beamer
+{
+
+/* packets are parsed, hashed and prefetched in stages of this many */
+const int BATCH_STAGE = 32;
+
+/* TCP below this goes by the ring, anything above by the id map */
+const int RESERVED_PORT_COUNT = 1024;
+
+/* packets to a VIP that isn't ours */
+const uint8_t NO_RING = 0xff;
+
+/* a stage's packets by class, as indices into the stage */
+struct StageClasses
+{
+	uint8_t ringPkts[BATCH_STAGE]; /* ring TCP, then ring UDP */
+	uint8_t idPkts[BATCH_STAGE];
+	int tcpCount;
+	int udpCount;
+	int idCount;
+	
+	int ringCount() const
+	{
+		return tcpCount + udpCount;
+	}
+};
+
+/*
+ * Splits a stage by class once, without branching: ring TCP, ring UDP and
+ * TCP to id ports each get a list of packet indices, and anything else is
+ * on none and passes through as is. pktRings has each packet's ring, or
+ * NO_RING for those that aren't ours; NULL if they all are.
+ */
+static inline void classifyStage(Packet **pkts, int count, const uint8_t *pktRings, StageClasses *classes)
+{
+	/* ports of packets that have none */
+	static const uint16_t NO_PORTS[2] = { 0, 0 };
+	
+	uint8_t udpPkts[BATCH_STAGE];
+	int tcpCount = 0;
+	int udpCount = 0;
+	int idCount = 0;
+	
+	/* every list gets written, only the right one grows */
+	for (int i = 0; i < count; i++)
+	{
+		const click_ip *ipHeader = pkts[i]->ip_header();
+		bool ours = !pktRings || pktRings[i] != NO_RING;
+		bool tcp = ours & (ipHeader->ip_p == IPPROTO_TCP);
+		bool udp = ours & (ipHeader->ip_p == IPPROTO_UDP);
+		
+		/* TCP and UDP both start with the ports */
+		const uint16_t *ports = (tcp | udp) ? reinterpret_cast<const uint16_t *>(pkts[i]->transport_header()) : NO_PORTS;
+		bool reserved = ntohs(ports[1]) < RESERVED_PORT_COUNT;
+		
+		classes->ringPkts[tcpCount] = i;
+		tcpCount += tcp & reserved;
+		classes->idPkts[idCount] = i;
+		idCount += tcp & !reserved;
+		udpPkts[udpCount] = i;
+		udpCount += udp;
+	}
+	for (int k = 0; k < udpCount; k++)
+		classes->ringPkts[tcpCount + k] = udpPkts[k];
+	
+	classes->tcpCount = tcpCount;
+	classes->udpCount = udpCount;
+	classes->idCount = idCount;
+}
+
+#if HAVE_BATCH
+/*
+ * Feeds a batch to stage(pkts, count) BATCH_STAGE packets at a time and
+ * links whatever comes out back into a batch: stages update packets in
+ * place, and may replace or drop (NULL) them.
+ */
+template <typename STAGE>
+static inline PacketBatch *runStages(PacketBatch *head, const STAGE &stage)
+{
+	Packet *pkts[BATCH_STAGE];
+	Packet *current = head;
+	Packet *first = NULL;
+	Packet *last = NULL;
+	unsigned int count = 0;
+	
+	while (current != NULL)
+	{
+		int stageCount = 0;
+		
+		while (current != NULL && stageCount < BATCH_STAGE)
+		{
+			pkts[stageCount++] = current;
+			current = current->next();
+		}
+		
+		stage(pkts, stageCount);
+		
+		for (int i = 0; i < stageCount; i++)
+		{
+			if (!pkts[i])
+				continue;
+			
+			if (last)
+				last->set_next(pkts[i]);
+			else
+				first = pkts[i];
+			last = pkts[i];
+			count++;
+		}
+	}
+	
+	if (!first)
+		return NULL;
+	
+	last->set_next(NULL);
+	return PacketBatch::make_from_simple_list(first, last, count);
+}
+#endif
+
+}
+
+CLICK_ENDDECLS
+
+#endif /* CLICK_BEAMER_BATCHSTAGE_HH */
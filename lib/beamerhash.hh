@@ -0,0 +1,98 @@
+#ifndef CLICK_BEAMER_BEAMERHASH_HH
+#define CLICK_BEAMER_BEAMERHASH_HH
+
+#include <click/config.h>
+#include <click/string.hh>
+#include "../../clickityclack/external/freebsdbob.hh"
+#include "p4crc32.hh"
+#include "toeplitz.hh"
+
+CLICK_DECLS
+
+namespace Beamer
+{
+
+/*
+ * Hash policies: what flows get bucketed by. Everything that buckets the
+ * same VIP (muxes, switches, the controller's view of the ring) has to use
+ * the same one. Ports are in network byte order.
+ */
+
+/* what the P4 switches compute; source address and port only */
+struct CRCHash
+{
+	static inline uint32_t hash(uint32_t saddr, uint16_t sport, uint16_t dport)
+	{
+		(void)dport;
+		HashTouple touple = { saddr, sport };
+		return p4_crc32_6((char *)&touple);
+	}
+	
+	static inline void hashBatch(const HashTouple *touples, const uint16_t *dports, uint32_t *hashes, int count)
+	{
+		(void)dports;
+		p4_crc32_6_batch(touples, hashes, count);
+	}
+};
+
+struct BOBHash
+{
+	static inline uint32_t hash(uint32_t saddr, uint16_t sport, uint16_t dport)
+	{
+		return freeBSDBob(saddr, sport, dport);
+	}
+	
+	static inline void hashBatch(const HashTouple *touples, const uint16_t *dports, uint32_t *hashes, int count)
+	{
+		for (int i = 0; i < count; i++)
+			hashes[i] = freeBSDBob(touples[i].src_ip, touples[i].src_port, dports[i]);
+	}
+};
+
+/*
+ * Toeplitz under TOEPLITZ_RSS_KEY over the source address and port. Only
+ * the low TOEPLITZ_RSS_RETA_BITS bits match what a NIC programmed with
+ * that key computes (see toeplitz_6()).
+ */
+struct ToeplitzHash
+{
+	static inline uint32_t hash(uint32_t saddr, uint16_t sport, uint16_t dport)
+	{
+		(void)dport;
+		HashTouple touple = { saddr, sport };
+		return toeplitz_6((char *)&touple);
+	}
+	
+	static inline void hashBatch(const HashTouple *touples, const uint16_t *dports, uint32_t *hashes, int count)
+	{
+		(void)dports;
+		toeplitz_6_batch(touples, hashes, count);
+	}
+};
+
+enum HashKind
+{
+	HASH_CRC,
+	HASH_BOB,
+	HASH_TOEPLITZ,
+};
+
+/* "CRC", "BOB" or "TOEPLITZ" */
+static inline bool parseHashKind(const String &name, HashKind *kind)
+{
+	if (name == "CRC")
+		*kind = HASH_CRC;
+	else if (name == "BOB")
+		*kind = HASH_BOB;
+	else if (name == "TOEPLITZ")
+		*kind = HASH_TOEPLITZ;
+	else
+		return false;
+	return true;
+}
+
+}
+
+CLICK_ENDDECLS
+
+#endif /* CLICK_BEAMER_BEAMERHASH_HH */
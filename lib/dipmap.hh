@@ -2,36 +2,152 @@
 #define CLICK_BEAMER_DIPMAP_HH
 
 #include <click/config.h>
+#include <click/glue.hh>
+#include <click/hashtable.hh>
+#include <click/string.hh>
+#include <click/vector.hh>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#if HAVE_NUMA
+#include <numa.h>
+#endif
+#include "quiescentstates.hh"
 
 CLICK_DECLS
 
 namespace Beamer
 {
 
+/*
+ * Readers take a View once per batch and look buckets up through it. Full
+ * rewrites (blob installs) go to a staging buffer that is published with a
+ * single pointer swap; the old buffer is only reused or freed once every
+ * reader that was in a batch at the swap has left it (see QuiescentStates),
+ * so a straggling reader at worst sees a stale ring, never freed memory.
+ *
+ * Buckets can be laid out in slices by their low bits, so that whatever
+ * only looks at some of them (a core behind RSS, see slice()) only
+ * touches its own slices, on its own NUMA node.
+ */
 template <typename MAP_ENTRY, typename LOG_HEADER> class DIPMapBase
 {
 public:
 	typedef MAP_ENTRY MapEntry;
 	typedef LOG_HEADER LogHeader;
+	typedef volatile MapEntry *View;
 	
 protected:
+	/* a replaced buffer, and where readers were when it was */
+	struct Retiree
+	{
+		MapEntry *entries;
+		QuiescentStates::Snapshot seen;
+	};
+	
 	unsigned long long count;
 	
 	volatile MapEntry *buf;
 	
+	MapEntry *staging;
+	Vector<Retiree> retired;
+	
+	/* NULL: no readers to wait for */
+	const QuiescentStates *readers;
+	
+	/* bucket b is at b >> sliceBits in slice b & sliceMask */
+	int sliceBits;
+	int sliceSizeBits;
+	unsigned long sliceMask;
+	Vector<int> sliceNodes;
+	
+	/* where bucket is in a buffer; just bucket if there are no slices */
+	unsigned long slot(unsigned long bucket) const
+	{
+		return ((bucket & sliceMask) << sliceSizeBits) | (bucket >> sliceBits);
+	}
+	
+	/* slices get bound to their nodes before anything touches them */
+	MapEntry *allocate() const
+	{
+		MapEntry *entries = new MAP_ENTRY[count]; assert(entries);
+		
+#if HAVE_NUMA
+		if (sliceNodes.size() && numa_available() >= 0)
+		{
+			uintptr_t page = sysconf(_SC_PAGESIZE);
+			uintptr_t sliceLen = (count >> sliceBits) * sizeof(MapEntry);
+			
+			for (int i = 0; i < sliceNodes.size(); i++)
+			{
+				/* whole pages only; one shared with the next slice stays wherever it lands */
+				uintptr_t start = ((uintptr_t)entries + i * sliceLen + page - 1) & ~(page - 1);
+				uintptr_t end = ((uintptr_t)entries + (i + 1) * sliceLen) & ~(page - 1);
+				
+				if (end > start)
+					numa_tonode_memory((void *)start, end - start, sliceNodes[i]);
+			}
+		}
+#endif
+		return entries;
+	}
+	
+	void release()
+	{
+		delete[] const_cast<MapEntry *>(buf);
+		delete[] staging;
+		for (int i = 0; i < retired.size(); i++)
+			delete[] retired[i].entries;
+		buf = NULL;
+		staging = NULL;
+		retired.clear();
+	}
+	
+	/* replaced buffers nobody can see anymore go to staging, or get freed */
+	void reclaim()
+	{
+		for (int i = 0; i < retired.size(); )
+		{
+			if (readers && !readers->passed(retired[i].seen))
+			{
+				i++;
+				continue;
+			}
+			
+			if (!staging)
+				staging = retired[i].entries;
+			else
+				delete[] retired[i].entries;
+			retired[i] = retired.back();
+			retired.pop_back();
+		}
+	}
+	
+private:
+	/* maps own their buffers */
+	DIPMapBase(const DIPMapBase &);
+	DIPMapBase &operator=(const DIPMapBase &);
+	
 public:
-	DIPMapBase() {}
+	DIPMapBase()
+		: count(0), buf(NULL), staging(NULL), readers(NULL), sliceBits(0), sliceSizeBits(0), sliceMask(0) {}
 	
-	DIPMapBase(unsigned long count)
-		: count(count)
+	~DIPMapBase()
 	{
-		buf = new MAP_ENTRY[count]; assert(buf);
-		memset(const_cast<MapEntry *>(buf), 0, sizeof(count * sizeof(MapEntry)));
+		release();
 	}
 	
+	/* before any readers are around */
 	void init(unsigned long count)
 	{
-		*this = DIPMapBase(count);
+		release();
+		this->count = count;
+		sliceBits = 0;
+		sliceSizeBits = 0;
+		sliceMask = 0;
+		sliceNodes.clear();
+		buf = allocate();
+		memset(const_cast<MapEntry *>(buf), 0, count * sizeof(MapEntry));
 	}
 	
 	unsigned long size() const
@@ -39,28 +155,155 @@ public:
 		return count;
 	}
 	
-	void updateEntry(unsigned long index, uint32_t dip, LogHeader header);
+	/* whose batches publish() has to outlast before a buffer is reused */
+	void setReaders(const QuiescentStates *readers)
+	{
+		this->readers = readers;
+	}
+	
+	/*
+	 * Lay buckets out in 2^bits slices by their low bits, slice i on NUMA
+	 * node nodes[i] where there's NUMA support. Right after init(), before
+	 * any entries go in; count has to be a power of 2 of at least 2^bits.
+	 */
+	bool slice(int bits, const Vector<int> &nodes)
+	{
+		if (bits <= 0 || count < (1ULL << bits) || (count & (count - 1)))
+			return false;
+		
+		sliceBits = bits;
+		sliceMask = (1UL << bits) - 1;
+		sliceSizeBits = 0;
+		while ((count >> bits) >> sliceSizeBits > 1)
+			sliceSizeBits++;
+		sliceNodes = nodes;
+		
+		/* nothing's in it yet: start over with a buffer that's placed right */
+		delete[] const_cast<MapEntry *>(buf);
+		buf = allocate();
+		memset(const_cast<MapEntry *>(buf), 0, count * sizeof(MapEntry));
+		return true;
+	}
+	
+	unsigned long slices() const
+	{
+		return sliceMask + 1;
+	}
+	
+	/* writers return 0, or -ENOSPC if the map has no room left for a DIP */
+	int updateEntry(unsigned long index, uint32_t dip, LogHeader header);
+	
+	/* like updateEntry, but with an explicit previous DIP */
+	int setEntry(unsigned long index, uint32_t dip, uint32_t prev, LogHeader header);
 	
-	void putEntries(unsigned long index, MapEntry *entries, unsigned long count)
+	/* called before dip may show up in concurrent updates */
+	int prepareDIP(uint32_t dip)
+	{
+		(void)dip;
+		return 0;
+	}
+	
+	int putEntries(unsigned long index, MapEntry *entries, unsigned long count)
 	{
 		for (unsigned long long i = 0; i < count; i++)
-			buf[index + i] = entries[i];
+			buf[slot(index + i)] = entries[i];
+		return 0;
+	}
+	
+	/*
+	 * Get a staging buffer ready; writer side only. Never waits: if readers
+	 * may still be on every replaced buffer, a fresh one gets allocated.
+	 */
+	void stage()
+	{
+		reclaim();
+		if (!staging)
+			staging = allocate();
+	}
+	
+	int putStagedEntries(unsigned long index, const MapEntry *entries, unsigned long count)
+	{
+		assert(staging);
+		
+		if (!sliceBits)
+		{
+			memcpy(staging + index, entries, count * sizeof(MapEntry));
+			return 0;
+		}
+		
+		for (unsigned long long i = 0; i < count; i++)
+			staging[slot(index + i)] = entries[i];
+		return 0;
+	}
+	
+	/* atomically replace the live buffer with the staged one */
+	void publish()
+	{
+		assert(staging);
+		
+		Retiree old;
+		
+		old.entries = const_cast<MapEntry *>(buf);
+		__atomic_store_n(&buf, staging, __ATOMIC_RELEASE);
+		staging = NULL;
+		if (readers)
+			readers->snapshot(&old.seen);
+		retired.push_back(old);
+	}
+	
+	View view() const
+	{
+		return __atomic_load_n(&buf, __ATOMIC_ACQUIRE);
+	}
+	
+	/* bucket already reduced to below size(); see the reduction policies below */
+	MapEntry at(View view, unsigned long bucket) const
+	{
+		return view[slot(bucket)];
+	}
+	
+	MapEntry get(View view, unsigned long hash) const
+	{
+		return at(view, hash % count);
+	}
+	
+	MapEntry get(unsigned long hash) const
+	{
+		return get(view(), hash);
+	}
+	
+	void prefetchAt(View view, unsigned long bucket) const
+	{
+		__builtin_prefetch(const_cast<MapEntry *>(&view[slot(bucket)]));
+	}
+	
+	void prefetch(View view, unsigned long hash) const
+	{
+		prefetchAt(view, hash % count);
 	}
 	
-	MapEntry get(unsigned long hash)
+	void prefetch(unsigned long hash) const
 	{
-		return buf[hash % count];
+		prefetch(view(), hash);
 	}
 };
 
 class PlainDIPMap: public DIPMapBase<uint32_t, int[0]>
 {
 public:
-	void updateEntry(unsigned long index, uint32_t dip, LogHeader header)
+	int updateEntry(unsigned long index, uint32_t dip, LogHeader header)
 	{
 		(void)header;
 		
-		buf[index] = dip;
+		buf[slot(index)] = dip;
+		return 0;
+	}
+	
+	int setEntry(unsigned long index, uint32_t dip, uint32_t prev, LogHeader header)
+	{
+		(void)prev;
+		
+		return updateEntry(index, dip, header);
 	}
 };
 
@@ -78,14 +321,10 @@ struct DIPHistoryEntry
 	DIPHistoryEntry(volatile const DIPHistoryEntry &other)
 		: current(other.current), prev(other.prev), timestamp(other.timestamp) {}
 	
-	volatile DIPHistoryEntry& operator = (const DIPHistoryEntry &other) volatile
+	/* whether connections may still be on prev, now being a Unix timestamp; branch-free, so it vectorizes */
+	bool inTransition(uint32_t now, uint32_t window) const
 	{
-		this->current = 0;
-		this->prev = other.prev;
-		this->timestamp = other.timestamp;
-		this->current = other.current;
-		
-		return *this;
+		return (prev != 0) & (prev != current) & ((int32_t)(now - timestamp) < (int32_t)window);
 	}
 } __attribute__((packed));
 
@@ -94,21 +333,472 @@ struct DIPHistoryLogHeader
 	uint32_t timestamp; /* Unix timestamp */
 } __attribute__((packed));
 
-class DIPHistoryMap: public DIPMapBase<DIPHistoryEntry, DIPHistoryLogHeader>
+/* a DIPHistoryEntry guarded by its own sequence counter; one per 16-byte slot */
+struct SeqDIPHistoryEntry
+{
+	uint32_t seq; /* odd while a writer is busy */
+	uint32_t current;
+	uint32_t prev;
+	uint32_t timestamp;
+} __attribute__((aligned(16)));
+
+/*
+ * Each bucket is a seqlock. Readers retry if they raced with a writer; the
+ * counter sits in the same line as the data, so the recheck is an L1 hit.
+ * Writers claim a bucket by making its counter odd, which also serializes
+ * the ZooKeeper thread against the assign handler.
+ */
+class DIPHistoryMap: public DIPMapBase<SeqDIPHistoryEntry, DIPHistoryLogHeader>
 {
+	static DIPHistoryEntry load(View view, unsigned long index)
+	{
+		volatile SeqDIPHistoryEntry *stored = &view[index];
+		DIPHistoryEntry entry;
+		uint32_t seq;
+		
+		do
+		{
+			seq = stored->seq;
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+			entry.current = stored->current;
+			entry.prev = stored->prev;
+			entry.timestamp = stored->timestamp;
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		}
+		while (unlikely((seq & 1) || stored->seq != seq));
+		
+		return entry;
+	}
+	
+	static uint32_t lock(volatile SeqDIPHistoryEntry *stored)
+	{
+		uint32_t seq;
+		
+		do
+		{
+			seq = stored->seq & ~1U;
+		}
+		while (!__atomic_compare_exchange_n(&stored->seq, &seq, seq + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED));
+		
+		return seq;
+	}
+	
+	static void unlock(volatile SeqDIPHistoryEntry *stored, uint32_t seq)
+	{
+		__atomic_store_n(&stored->seq, seq + 2, __ATOMIC_RELEASE);
+	}
+	
 public:
-	void updateEntry(unsigned long index, uint32_t dip, LogHeader header)
+	typedef DIPHistoryEntry MapEntry;
+	
+	int updateEntry(unsigned long index, uint32_t dip, LogHeader header)
 	{
-		volatile MapEntry *entry = &buf[index];
+		volatile SeqDIPHistoryEntry *stored = &buf[slot(index)];
+		uint32_t seq = lock(stored);
 		
 		/* the DIP might see current == prev; handle this case carefully */
 		
-		entry->prev = entry->current;
-		entry->timestamp = header.timestamp; 
-		entry->current = dip;
+		stored->prev = stored->current;
+		stored->timestamp = header.timestamp;
+		stored->current = dip;
+		
+		unlock(stored, seq);
+		return 0;
+	}
+	
+	int setEntry(unsigned long index, uint32_t dip, uint32_t prev, LogHeader header)
+	{
+		volatile SeqDIPHistoryEntry *stored = &buf[slot(index)];
+		uint32_t seq = lock(stored);
+		
+		stored->prev = prev;
+		stored->timestamp = header.timestamp;
+		stored->current = dip;
+		
+		unlock(stored, seq);
+		return 0;
+	}
+	
+	int putEntries(unsigned long index, const MapEntry *entries, unsigned long count)
+	{
+		for (unsigned long long i = 0; i < count; i++)
+		{
+			volatile SeqDIPHistoryEntry *stored = &buf[slot(index + i)];
+			uint32_t seq = lock(stored);
+			
+			stored->current = entries[i].current;
+			stored->prev = entries[i].prev;
+			stored->timestamp = entries[i].timestamp;
+			
+			unlock(stored, seq);
+		}
+		return 0;
+	}
+	
+	/* nobody reads the staging buffer, so no need for the seqlock */
+	int putStagedEntries(unsigned long index, const MapEntry *entries, unsigned long count)
+	{
+		assert(staging);
+		
+		for (unsigned long long i = 0; i < count; i++)
+		{
+			SeqDIPHistoryEntry *stored = &staging[slot(index + i)];
+			
+			stored->seq = 0;
+			stored->current = entries[i].current;
+			stored->prev = entries[i].prev;
+			stored->timestamp = entries[i].timestamp;
+		}
+		return 0;
+	}
+	
+	MapEntry at(View view, unsigned long bucket) const
+	{
+		return load(view, slot(bucket));
+	}
+	
+	MapEntry get(View view, unsigned long hash) const
+	{
+		return at(view, hash % count);
+	}
+	
+	MapEntry get(unsigned long hash) const
+	{
+		return get(view(), hash);
 	}
 };
 
+/*
+ * Maps DIPs to small indices, so that buckets don't need to store full
+ * addresses. Index 0 is DIP 0 (unassigned). Indices are never recycled, so
+ * readers can translate without synchronization. Writers (the assign
+ * handler, the ZooKeeper thread and its replay workers) take the lock.
+ */
+class DIPTable
+{
+public:
+	static const int MAX_DIPS = 0x10000;
+	
+private:
+	uint32_t *dips;
+	int dipCount;
+	HashTable<uint32_t, uint16_t> indices;
+	pthread_mutex_t writeLock;
+	
+public:
+	DIPTable()
+		: dipCount(1)
+	{
+		dips = new uint32_t[MAX_DIPS]; assert(dips);
+		memset(dips, 0, MAX_DIPS * sizeof(uint32_t));
+		indices.set(0, 0);
+		pthread_mutex_init(&writeLock, NULL);
+	}
+	
+	~DIPTable()
+	{
+		delete[] dips;
+		pthread_mutex_destroy(&writeLock);
+	}
+	
+	uint32_t get(uint16_t index) const
+	{
+		return dips[index];
+	}
+	
+	void lock()
+	{
+		pthread_mutex_lock(&writeLock);
+	}
+	
+	void unlock()
+	{
+		pthread_mutex_unlock(&writeLock);
+	}
+	
+	/* with the lock held; -ENOSPC once all MAX_DIPS indices are taken */
+	int insert(uint32_t dip)
+	{
+		HashTable<uint32_t, uint16_t>::iterator it = indices.find(dip);
+		
+		if (it != indices.end())
+			return it.value();
+		
+		if (dipCount >= MAX_DIPS)
+			return -ENOSPC;
+		
+		/* publish the address before anyone can see the index */
+		dips[dipCount] = dip;
+		click_compiler_fence();
+		indices.set(dip, dipCount);
+		
+		return dipCount++;
+	}
+	
+	int indexOf(uint32_t dip)
+	{
+		lock();
+		int index = insert(dip);
+		unlock();
+		
+		return index;
+	}
+};
+
+/* aligned so that a bucket never straddles two cache lines */
+union CompactDIPHistoryEntry
+{
+	struct
+	{
+		uint16_t current; /* DIP table index */
+		uint16_t prev;    /* DIP table index */
+		uint32_t timestamp; /* Unix timestamp */
+	};
+	uint64_t raw;
+} __attribute__((aligned(8)));
+
+/*
+ * DIPHistoryMap with 8-byte buckets that refer to DIPs through a DIPTable.
+ * It speaks DIPHistoryEntry to the outside world, so ZKClient blobs, logs and
+ * dumps are unaffected. Buckets are read and written as one 64-bit word.
+ */
+class CompactDIPHistoryMap: public DIPMapBase<CompactDIPHistoryEntry, DIPHistoryLogHeader>
+{
+	DIPTable *dipTable;
+	
+	static CompactDIPHistoryEntry load(View view, unsigned long index)
+	{
+		CompactDIPHistoryEntry stored;
+		
+		stored.raw = view[index].raw;
+		return stored;
+	}
+	
+	/* buckets whose DIPs don't fit are left unassigned */
+	int translate(volatile CompactDIPHistoryEntry *dst, unsigned long index, const DIPHistoryEntry *entries, unsigned long count)
+	{
+		int err = 0;
+		
+		dipTable->lock();
+		for (unsigned long long i = 0; i < count; i++)
+		{
+			CompactDIPHistoryEntry entry;
+			int current = dipTable->insert(entries[i].current);
+			int prev = dipTable->insert(entries[i].prev);
+			
+			if (current < 0 || prev < 0)
+			{
+				err = -ENOSPC;
+				current = 0;
+				prev = 0;
+			}
+			entry.current = current;
+			entry.prev = prev;
+			entry.timestamp = entries[i].timestamp;
+			
+			dst[slot(index + i)].raw = entry.raw;
+		}
+		dipTable->unlock();
+		
+		return err;
+	}
+	
+public:
+	typedef DIPHistoryEntry MapEntry;
+	
+	CompactDIPHistoryMap()
+		: dipTable(NULL) {}
+	
+	~CompactDIPHistoryMap()
+	{
+		delete dipTable;
+	}
+	
+	void init(unsigned long count)
+	{
+		DIPMapBase<CompactDIPHistoryEntry, DIPHistoryLogHeader>::init(count);
+		if (!dipTable)
+		{
+			dipTable = new DIPTable(); assert(dipTable);
+		}
+	}
+	
+	/* one compare-and-swap, so concurrent writers to a bucket don't lose prev */
+	int updateEntry(unsigned long index, uint32_t dip, LogHeader header)
+	{
+		int current = dipTable->indexOf(dip);
+		
+		if (current < 0)
+			return current;
+		
+		volatile CompactDIPHistoryEntry *stored = &buf[slot(index)];
+		CompactDIPHistoryEntry old;
+		CompactDIPHistoryEntry entry;
+		
+		old.raw = stored->raw;
+		do
+		{
+			entry.prev = old.current;
+			entry.timestamp = header.timestamp;
+			entry.current = current;
+		}
+		while (!__atomic_compare_exchange_n(&stored->raw, &old.raw, entry.raw, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+		
+		return 0;
+	}
+	
+	int setEntry(unsigned long index, uint32_t dip, uint32_t prev, LogHeader header)
+	{
+		CompactDIPHistoryEntry entry;
+		int prevIndex = dipTable->indexOf(prev);
+		int current = dipTable->indexOf(dip);
+		
+		if (prevIndex < 0 || current < 0)
+			return -ENOSPC;
+		
+		entry.prev = prevIndex;
+		entry.timestamp = header.timestamp;
+		entry.current = current;
+		
+		__atomic_store_n(&buf[slot(index)].raw, entry.raw, __ATOMIC_RELEASE);
+		return 0;
+	}
+	
+	/* gets DIPs their indices before replay goes parallel */
+	int prepareDIP(uint32_t dip)
+	{
+		int index = dipTable->indexOf(dip);
+		
+		return index < 0 ? index : 0;
+	}
+	
+	int putEntries(unsigned long index, const MapEntry *entries, unsigned long count)
+	{
+		return translate(buf, index, entries, count);
+	}
+	
+	int putStagedEntries(unsigned long index, const MapEntry *entries, unsigned long count)
+	{
+		assert(staging);
+		
+		return translate(staging, index, entries, count);
+	}
+	
+	MapEntry at(View view, unsigned long bucket) const
+	{
+		CompactDIPHistoryEntry stored = load(view, slot(bucket));
+		MapEntry entry;
+		
+		entry.current = dipTable->get(stored.current);
+		entry.prev = dipTable->get(stored.prev);
+		entry.timestamp = stored.timestamp;
+		
+		return entry;
+	}
+	
+	MapEntry get(View view, unsigned long hash) const
+	{
+		return at(view, hash % count);
+	}
+	
+	MapEntry get(unsigned long hash) const
+	{
+		return get(view(), hash);
+	}
+};
+
+/*
+ * Bucket reduction policies: how a hash picks one of count buckets. Like
+ * the hash itself, it has to be the same everywhere a VIP gets bucketed.
+ * MaskReduction is ModuloReduction without the division, for rings whose
+ * size is a power of 2; MultiplyShiftReduction works for any size, but
+ * spreads hashes over the ring differently.
+ */
+struct ModuloReduction
+{
+	static inline unsigned long bucket(uint32_t hash, unsigned long count)
+	{
+		return hash % count;
+	}
+	
+	static bool fits(unsigned long count)
+	{
+		return count > 0;
+	}
+};
+
+struct MaskReduction
+{
+	static inline unsigned long bucket(uint32_t hash, unsigned long count)
+	{
+		return hash & (count - 1);
+	}
+	
+	static bool fits(unsigned long count)
+	{
+		return count > 0 && !(count & (count - 1));
+	}
+};
+
+struct MultiplyShiftReduction
+{
+	static inline unsigned long bucket(uint32_t hash, unsigned long count)
+	{
+		return ((uint64_t)hash * count) >> 32;
+	}
+	
+	static bool fits(unsigned long count)
+	{
+		return count > 0 && count <= 0x100000000ULL;
+	}
+};
+
+enum ReductionKind
+{
+	REDUCE_MODULO,
+	REDUCE_MASK,
+	REDUCE_MULTIPLY_SHIFT,
+};
+
+/* "MODULO", "MASK" or "MULTIPLY_SHIFT" */
+static inline bool parseReductionKind(const String &name, ReductionKind *kind)
+{
+	if (name == "MODULO")
+		*kind = REDUCE_MODULO;
+	else if (name == "MASK")
+		*kind = REDUCE_MASK;
+	else if (name == "MULTIPLY_SHIFT")
+		*kind = REDUCE_MULTIPLY_SHIFT;
+	else
+		return false;
+	return true;
+}
+
+/* whether kind can reduce hashes to count buckets */
+static inline bool reductionFits(ReductionKind kind, unsigned long count)
+{
+	switch (kind)
+	{
+	case REDUCE_MASK:
+		return MaskReduction::fits(count);
+	case REDUCE_MULTIPLY_SHIFT:
+		return MultiplyShiftReduction::fits(count);
+	default:
+		return ModuloReduction::fits(count);
+	}
+}
+
+#ifndef CLICK_BEAMER_COMPACT_RING
+#define CLICK_BEAMER_COMPACT_RING 0
+#endif
+
+/* the bucket map used by the muxes */
+#if CLICK_BEAMER_COMPACT_RING
+typedef CompactDIPHistoryMap RingMap;
+#else
+typedef DIPHistoryMap RingMap;
+#endif
+
 }
 
 CLICK_ENDDECLS
@@ -4,11 +4,16 @@
 #include <click/config.h>
 #include <click/glue.hh>
 #include <click/string.hh>
+#include <click/vector.hh>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <unistd.h>
+#include <zlib.h>
+#include <pthread.h>
 #include "zkclient.hh"
 
 CLICK_DECLS
@@ -18,99 +23,415 @@ namespace Beamer
 
 template <typename DIP_MAP> class ZKClient;
 
-#define CLICK_BEAMER_DUMPER_CHECK(stuff) \
-	{ \
-		int err = (stuff); \
-		if (err < 0) \
-			return err; \
-	}
-		
 namespace Dumper
 {
-	int writeAll(int fd,  const void *buf, size_t count)
+	/*
+	 * Snapshot layout: a SnapshotHeader followed by ringSize raw MapEntry
+	 * records, in host byte order. The file is meant to be mmap()ed back
+	 * on the same kind of box that wrote it.
+	 */
+	static const uint32_t SNAPSHOT_MAGIC = 0x424d5253; /* "BMRS" */
+	static const uint32_t SNAPSHOT_VERSION = 1;
+	
+	struct SnapshotHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t entrySize;
+		int32_t gen;
+		uint64_t ringSize;
+		uint32_t checksum; /* CRC32 of the entry array */
+		uint32_t reserved;
+	} __attribute__((packed));
+	
+	/* a map copied out at a single generation */
+	struct Snapshot
+	{
+		SnapshotHeader header;
+		char *data;
+		
+		Snapshot()
+			: data(NULL) {}
+		
+		~Snapshot()
+		{
+			delete[] data;
+		}
+		
+		uint64_t dataSize() const
+		{
+			return header.ringSize * header.entrySize;
+		}
+		
+		uint64_t fileSize() const
+		{
+			return sizeof(SnapshotHeader) + dataSize();
+		}
+	};
+	
+	/*
+	 * Only holds off ZooKeeper updates for the copy, not for checksumming
+	 * and writing. Packet processing is never blocked.
+	 */
+	template <typename DIP_MAP> int capture(ZKClient<DIP_MAP> *client, Snapshot *snap)
+	{
+		typedef typename DIP_MAP::MapEntry MapEntry;
+		
+		DIP_MAP *dipMap = client->getDIPMap();
+		unsigned long size = dipMap->size();
+		
+		delete[] snap->data;
+		snap->data = new char[size * sizeof(MapEntry)]; assert(snap->data);
+		
+		MapEntry *entries = (MapEntry *)snap->data;
+		
+		client->lockUpdates();
+		typename DIP_MAP::View view = dipMap->view();
+		for (unsigned long i = 0; i < size; i++)
+			entries[i] = dipMap->get(view, i);
+		snap->header.gen = client->getGen();
+		client->unlockUpdates();
+		
+		snap->header.magic = SNAPSHOT_MAGIC;
+		snap->header.version = SNAPSHOT_VERSION;
+		snap->header.entrySize = sizeof(MapEntry);
+		snap->header.ringSize = size;
+		snap->header.checksum = crc32(crc32(0, Z_NULL, 0), (const Bytef *)snap->data, snap->dataSize());
+		snap->header.reserved = 0;
+		
+		return 0;
+	}
+	
+	/* bytes per writev() */
+	static const uint64_t SNAPSHOT_WRITE_CHUNK = 8 << 20;
+	
+	/* progress, if given, is bumped as bytes hit the file */
+	static inline int writeSnapshot(int fd, const Snapshot *snap, volatile uint64_t *progress = NULL)
 	{
-		size_t written = 0;
+		uint64_t offset = 0;
+		uint64_t total = snap->fileSize();
 		
-		while (written < count)
+		while (offset < total)
 		{
-			ssize_t bytes = write(fd, (char *)buf + written, count - written);
+			struct iovec iov[2];
+			int iovcnt = 0;
+			uint64_t dataOffset = 0;
+			
+			if (offset < sizeof(SnapshotHeader))
+			{
+				iov[iovcnt].iov_base = (char *)&snap->header + offset;
+				iov[iovcnt].iov_len = sizeof(SnapshotHeader) - offset;
+				iovcnt++;
+			}
+			else
+			{
+				dataOffset = offset - sizeof(SnapshotHeader);
+			}
+			
+			uint64_t len = snap->dataSize() - dataOffset;
+			if (len > SNAPSHOT_WRITE_CHUNK)
+				len = SNAPSHOT_WRITE_CHUNK;
+			if (len > 0)
+			{
+				iov[iovcnt].iov_base = snap->data + dataOffset;
+				iov[iovcnt].iov_len = len;
+				iovcnt++;
+			}
+			
+			ssize_t bytes = writev(fd, iov, iovcnt);
 			if (bytes == 0)
 				return -EIO;
-			if (bytes > 0)
+			if (bytes < 0)
 			{
-				written += bytes;
-				continue;
+				if (errno == EAGAIN || errno == EINTR || errno == EWOULDBLOCK)
+					continue;
+				return -errno;
 			}
-			if (errno == EAGAIN || errno == EINTR || errno == EWOULDBLOCK)
-				continue;
 			
-			return -errno;
+			offset += bytes;
+			if (progress)
+				*progress = offset;
 		}
-		return count;
+		
+		return 0;
 	}
 	
-	template <typename T> int writeObj(int fd,  const T stuff)
+	/* write to a temp file and rename it over, so a loader never sees half a snapshot */
+	static inline int writeSnapshot(String filename, const Snapshot *snap, volatile uint64_t *progress = NULL)
 	{
-		return writeAll(fd, &stuff, sizeof(T));
+		String tmpName = filename + ".tmp";
+		
+		int fd = open(tmpName.c_str(), O_WRONLY | O_TRUNC | O_CREAT, 0600);
+		if (fd < 0)
+			return -errno;
+		
+		int ret = writeSnapshot(fd, snap, progress);
+		if (close(fd) < 0 && ret == 0)
+			ret = -errno;
+		if (ret == 0 && rename(tmpName.c_str(), filename.c_str()) < 0)
+			ret = -errno;
+		if (ret < 0)
+			unlink(tmpName.c_str());
+		return ret;
 	}
-
-	template <typename T> int dump(T *dumpee, int fd);
 	
-	template <> int dump<DIPHistoryMap>(DIPHistoryMap *dumpee, int fd)
+	template <typename DIP_MAP> int dump(ZKClient<DIP_MAP> *dumpee, int fd)
 	{
-		unsigned long size = dumpee->size();
-		CLICK_BEAMER_DUMPER_CHECK(writeObj(fd, (uint32_t)size));
-		for (unsigned long i = 0; i < size; i++)
+		Snapshot snap;
+		
+		int err = capture(dumpee, &snap);
+		if (err < 0)
+			return err;
+		return writeSnapshot(fd, &snap);
+	}
+	
+	template <typename DIP_MAP> int dump(ZKClient<DIP_MAP> *dumpee, String filename)
+	{
+		Snapshot snap;
+		
+		int err = capture(dumpee, &snap);
+		if (err < 0)
+			return err;
+		return writeSnapshot(filename, &snap);
+	}
+	
+	/*
+	 * Install a snapshot into the (already sized) map and tell the client
+	 * which generation it's at, so it catches up from the logs instead of
+	 * fetching a blob. Must run before the client is synced.
+	 */
+	template <typename DIP_MAP> int load(ZKClient<DIP_MAP> *loadee, String filename)
+	{
+		typedef typename DIP_MAP::MapEntry MapEntry;
+		
+		DIP_MAP *dipMap = loadee->getDIPMap();
+		struct stat st;
+		
+		int fd = open(filename.c_str(), O_RDONLY);
+		if (fd < 0)
+			return -errno;
+		
+		if (fstat(fd, &st) < 0)
+		{
+			int err = -errno;
+			close(fd);
+			return err;
+		}
+		
+		if ((size_t)st.st_size < sizeof(SnapshotHeader))
+		{
+			close(fd);
+			return -EINVAL;
+		}
+		
+		void *mem = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (mem == MAP_FAILED)
+			return -errno;
+		madvise(mem, st.st_size, MADV_SEQUENTIAL);
+		
+		const SnapshotHeader *header = (const SnapshotHeader *)mem;
+		const MapEntry *entries = (const MapEntry *)(header + 1);
+		int err = 0;
+		
+		if (header->magic != SNAPSHOT_MAGIC || header->version != SNAPSHOT_VERSION || header->entrySize != sizeof(MapEntry))
+			err = -EINVAL;
+		else if (header->ringSize != dipMap->size() || header->gen < 0)
+			err = -EINVAL;
+		else if ((uint64_t)st.st_size != sizeof(SnapshotHeader) + header->ringSize * sizeof(MapEntry))
+			err = -EINVAL;
+		else if (crc32(crc32(0, Z_NULL, 0), (const Bytef *)entries, header->ringSize * sizeof(MapEntry)) != header->checksum)
+			err = -EBADMSG;
+		
+		if (err == 0)
+		{
+			dipMap->stage();
+			err = dipMap->putStagedEntries(0, entries, header->ringSize);
+		}
+		if (err == 0)
 		{
-			DIPHistoryEntry entry = dumpee->get(i);
-			CLICK_BEAMER_DUMPER_CHECK(writeObj(fd, entry.current));
-			CLICK_BEAMER_DUMPER_CHECK(writeObj(fd, entry.prev));
-			CLICK_BEAMER_DUMPER_CHECK(writeObj(fd, entry.timestamp));
+			dipMap->publish();
+			loadee->warmStart(header->gen);
 		}
+		
+		munmap(mem, st.st_size);
+		return err;
 	}
+}
+
+/*
+ * Dumps a set of maps from a background thread. Each map is captured and
+ * written in turn; status() can be polled from handlers meanwhile.
+ */
+class DumpJob
+{
+public:
+	enum Status
+	{
+		IDLE,
+		RUNNING,
+		DONE,
+		FAILED,
+	};
 	
-	template <> int dump<PlainDIPMap>(PlainDIPMap *dumpee, int fd)
+private:
+	struct Target
 	{
-		unsigned long size = dumpee->size();
-		CLICK_BEAMER_DUMPER_CHECK(writeObj(fd, (uint32_t)size));
-		for (unsigned long i = 0; i < size; i++)
+		String filename;
+		
+		virtual ~Target() {}
+		
+		virtual int capture(Dumper::Snapshot *snap) = 0;
+	};
+	
+	template <typename DIP_MAP> struct ClientTarget: public Target
+	{
+		ZKClient<DIP_MAP> *client;
+		
+		int capture(Dumper::Snapshot *snap)
+		{
+			return Dumper::capture(client, snap);
+		}
+	};
+	
+	Vector<Target *> targets;
+	pthread_t thread;
+	bool joinable;
+	
+	volatile Status state;
+	volatile int current;
+	volatile uint64_t written;
+	volatile uint64_t total;
+	volatile int32_t gen;
+	int err;
+	
+	static void *run(void *arg)
+	{
+		DumpJob *me = (DumpJob *)arg;
+		
+		for (int i = 0; i < me->targets.size(); i++)
 		{
-			uint32_t ip = dumpee->get(i);
-			CLICK_BEAMER_DUMPER_CHECK(writeObj(fd, ip));
+			Dumper::Snapshot snap;
+			
+			me->current = i;
+			me->written = 0;
+			me->total = 0;
+			
+			int err = me->targets[i]->capture(&snap);
+			if (err == 0)
+			{
+				me->gen = snap.header.gen;
+				me->total = snap.fileSize();
+				err = Dumper::writeSnapshot(me->targets[i]->filename, &snap, &me->written);
+			}
+			
+			if (err < 0)
+			{
+				me->err = err;
+				__atomic_store_n(&me->state, FAILED, __ATOMIC_RELEASE);
+				return NULL;
+			}
 		}
+		
+		__atomic_store_n(&me->state, DONE, __ATOMIC_RELEASE);
+		return NULL;
 	}
 	
-//	template <>
-//	template <typename T>
-//	int dump<ZKClient<T> >(ZKClient<T> *dumpee, int fd)
-//	{
-//		CLICK_BEAMER_DUMPER_CHECK(writeObj(fd, dumpee->getGen()));
-//		CLICK_BEAMER_DUMPER_CHECK(writeObj(fd, dumpee->getDIPMap()));
-//	}
+public:
+	DumpJob()
+		: joinable(false), state(IDLE), current(0), written(0), total(0), gen(-1), err(0) {}
 	
-	template <> int dump<ZKClient<DIPHistoryMap> >(ZKClient<DIPHistoryMap> *dumpee, int fd)
+	/* wait for the last dump to finish */
+	void join()
 	{
-		CLICK_BEAMER_DUMPER_CHECK(writeObj(fd, (uint32_t)dumpee->getGen()));
-		CLICK_BEAMER_DUMPER_CHECK(dump(dumpee->getDIPMap(), fd));
+		if (!joinable)
+			return;
+		
+		pthread_join(thread, NULL);
+		joinable = false;
 	}
 	
-	template <> int dump<ZKClient<PlainDIPMap> >(ZKClient<PlainDIPMap> *dumpee, int fd)
+	bool busy() const
 	{
-		CLICK_BEAMER_DUMPER_CHECK(writeObj(fd, (uint32_t)dumpee->getGen()));
-		CLICK_BEAMER_DUMPER_CHECK(dump(dumpee->getDIPMap(), fd));
+		return __atomic_load_n(&state, __ATOMIC_ACQUIRE) == RUNNING;
 	}
 	
-	template <typename T> int dump(T *dumpee, String filename)
+	/* forget the previous dump's targets; not while busy() */
+	void clear()
 	{
-		int fd = open(filename.c_str(), O_WRONLY | O_TRUNC | O_CREAT, 0600);
-		if (fd < 0)
-			return -errno;
-		int ret = dump(dumpee, fd);
-		close(fd);
-		return ret;
+		assert(!busy());
+		join();
 		
+		for (int i = 0; i < targets.size(); i++)
+			delete targets[i];
+		targets.clear();
+		state = IDLE;
 	}
-}
+	
+	template <typename DIP_MAP> void add(ZKClient<DIP_MAP> *client, String filename)
+	{
+		assert(!busy());
+		
+		ClientTarget<DIP_MAP> *target = new ClientTarget<DIP_MAP>(); assert(target);
+		target->client = client;
+		target->filename = filename;
+		targets.push_back(target);
+	}
+	
+	int start()
+	{
+		if (busy())
+			return -EBUSY;
+		join();
+		
+		current = 0;
+		written = 0;
+		total = 0;
+		gen = -1;
+		err = 0;
+		state = RUNNING;
+		
+		int ret = pthread_create(&thread, NULL, run, this);
+		if (ret != 0)
+		{
+			state = FAILED;
+			err = -ret;
+			return -ret;
+		}
+		
+		joinable = true;
+		return 0;
+	}
+	
+	String status() const
+	{
+		switch (__atomic_load_n(&state, __ATOMIC_ACQUIRE))
+		{
+		case IDLE:
+			return "idle";
+			
+		case RUNNING:
+			return String("running ") + targets[current]->filename + " " + String(written) + "/" + String(total);
+			
+		case DONE:
+			return String("done gen ") + String(gen);
+			
+		case FAILED:
+		default:
+			if (targets.size() == 0)
+				return String("failed: ") + strerror(-err);
+			return String("failed ") + targets[current]->filename + ": " + strerror(-err);
+		}
+	}
+	
+	~DumpJob()
+	{
+		join();
+		
+		for (int i = 0; i < targets.size(); i++)
+			delete targets[i];
+	}
+};
 
 }
 
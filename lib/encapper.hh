@@ -0,0 +1,255 @@
+#ifndef CLICK_BEAMER_ENCAPPER_HH
+#define CLICK_BEAMER_ENCAPPER_HH
+
+#include <click/config.h>
+#include <click/string.hh>
+#include <click/packet.hh>
+#include <click/glue.hh>
+
+CLICK_DECLS
+
+namespace Beamer
+{
+
+/*
+ * Fully built outer headers, cached per CPU and keyed on everything that
+ * goes into them, with the checksum computed for ip_len == 0; a hit costs
+ * a header copy plus a length fixup. Stale entries never match once the
+ * bucket or gen changes, so nothing needs invalidating. HEADER carries the
+ * PrevDIP metadata, PLAIN_HEADER doesn't; BUILDER fills either in with
+ * build(header, vip, dip[, pdip, ts, gen]).
+ */
+template <typename HEADER, typename PLAIN_HEADER>
+class HeaderCache
+{
+	struct Entry
+	{
+		uint32_t vip;
+		uint32_t dip;
+		uint32_t pdip;
+		uint32_t ts;
+		uint32_t gen;
+		HEADER hdr;
+	} __attribute__((aligned(64)));
+	
+	struct PlainEntry
+	{
+		uint32_t vip;
+		uint32_t dip;
+		PLAIN_HEADER hdr;
+	} __attribute__((aligned(32)));
+	
+	/* per CPU, for each kind; must be a power of 2 */
+	static const int CACHE_SIZE = 128;
+	
+	struct CPUCache
+	{
+		Entry entries[CACHE_SIZE];
+		PlainEntry plain[CACHE_SIZE];
+	};
+	
+	CPUCache *caches;
+	
+	static inline int slot(uint32_t dip, uint32_t pdip, uint32_t ts, uint32_t gen)
+	{
+		uint32_t h = dip ^ (pdip >> 5) ^ ts ^ gen;
+		
+		h ^= h >> 16;
+		h ^= h >> 8;
+		return h & (CACHE_SIZE - 1);
+	}
+	
+	template <typename BUILDER>
+	static void fill(BUILDER *builder, Entry *cached, uint32_t vip, uint32_t dip, uint32_t pdip, uint32_t ts, uint32_t gen)
+	{
+		builder->build(&cached->hdr, vip, dip, pdip, ts, gen);
+		cached->vip = vip;
+		cached->dip = dip;
+		cached->pdip = pdip;
+		cached->ts = ts;
+		cached->gen = gen;
+	}
+	
+	template <typename BUILDER>
+	static void fill(BUILDER *builder, PlainEntry *cached, uint32_t vip, uint32_t dip)
+	{
+		builder->build(&cached->hdr, vip, dip);
+		cached->vip = vip;
+		cached->dip = dip;
+	}
+	
+	HeaderCache(const HeaderCache &);
+	HeaderCache &operator=(const HeaderCache &);
+	
+public:
+	HeaderCache()
+	{
+		caches = new CPUCache[click_max_cpu_ids()]; assert(caches);
+	}
+	
+	~HeaderCache()
+	{
+		delete[] caches;
+	}
+	
+	/* every slot starts out holding a valid header for an all-zero key; again whenever the templates change */
+	template <typename BUILDER>
+	void reset(BUILDER *builder)
+	{
+		for (int i = 0; i < click_max_cpu_ids(); i++)
+		{
+			for (int j = 0; j < CACHE_SIZE; j++)
+			{
+				fill(builder, &caches[i].entries[j], 0, 0, 0, 0, 0);
+				fill(builder, &caches[i].plain[j], 0, 0);
+			}
+		}
+	}
+	
+	/* this CPU's header for the key, built on a miss */
+	template <typename BUILDER>
+	HEADER *get(BUILDER *builder, uint32_t vip, uint32_t dip, uint32_t pdip, uint32_t ts, uint32_t gen)
+	{
+		Entry *cached = &caches[click_current_cpu_id()].entries[slot(dip, pdip, ts, gen)];
+		
+		if (cached->dip != dip || cached->pdip != pdip || cached->ts != ts || cached->gen != gen || cached->vip != vip)
+			fill(builder, cached, vip, dip, pdip, ts, gen);
+		return &cached->hdr;
+	}
+	
+	template <typename BUILDER>
+	PLAIN_HEADER *getPlain(BUILDER *builder, uint32_t vip, uint32_t dip)
+	{
+		PlainEntry *cached = &caches[click_current_cpu_id()].plain[slot(dip, 0, 0, 0)];
+		
+		if (cached->dip != dip || cached->vip != vip)
+			fill(builder, cached, vip, dip);
+		return &cached->hdr;
+	}
+};
+
+}
+
+CLICK_ENDDECLS
+
+/* they use HeaderCache, and include this first for it */
+#include "ggencapper.hh"
+#include "gueencapper.hh"
+
+CLICK_DECLS
+
+namespace Beamer
+{
+
+/*
+ * The outer headers the muxes have on hand; an encapsulation policy below
+ * picks which to use. hash only matters to GUE.
+ */
+class Encapper
+{
+public:
+	GGEncapper gg;
+	GUEEncapper gue;
+	
+	void setGUEPort(uint16_t port)
+	{
+		gue.setPort(port);
+	}
+	
+	/* for flows that didn't get hashed on the way */
+	static inline uint32_t entropy(uint32_t saddr, uint16_t sport)
+	{
+		return (saddr ^ sport) * 0x9e3779b1;
+	}
+};
+
+/*
+ * Encapsulation policies. METADATA says whether the policy ever carries
+ * the PrevDIP metadata; if it doesn't, encapsulate() never gets called and
+ * whatever decides when to call it compiles away.
+ */
+
+/* plain IP in IP, never any metadata */
+struct IPIPEncap
+{
+	static const bool METADATA = false;
+	
+	static inline WritablePacket *encapsulate(Encapper *e, Packet *p, uint32_t vip, uint32_t dip, uint32_t pdip, uint32_t ts, uint32_t gen, uint32_t hash)
+	{
+		(void)pdip; (void)ts; (void)gen; (void)hash;
+		return e->gg.encapsulateIPIP(p, vip, dip);
+	}
+	
+	static inline WritablePacket *encapsulatePlain(Encapper *e, Packet *p, uint32_t vip, uint32_t dip, uint32_t hash)
+	{
+		(void)hash;
+		return e->gg.encapsulateIPIP(p, vip, dip);
+	}
+};
+
+/* IP in IP, metadata in an IP option */
+struct GGEncap
+{
+	static const bool METADATA = true;
+	
+	static inline WritablePacket *encapsulate(Encapper *e, Packet *p, uint32_t vip, uint32_t dip, uint32_t pdip, uint32_t ts, uint32_t gen, uint32_t hash)
+	{
+		(void)hash;
+		return e->gg.encapsulate(p, vip, dip, pdip, ts, gen);
+	}
+	
+	static inline WritablePacket *encapsulatePlain(Encapper *e, Packet *p, uint32_t vip, uint32_t dip, uint32_t hash)
+	{
+		(void)hash;
+		return e->gg.encapsulateIPIP(p, vip, dip);
+	}
+};
+
+/* metadata in the GUE header, flow entropy in the UDP source port */
+struct GUEEncap
+{
+	static const bool METADATA = true;
+	
+	static inline WritablePacket *encapsulate(Encapper *e, Packet *p, uint32_t vip, uint32_t dip, uint32_t pdip, uint32_t ts, uint32_t gen, uint32_t hash)
+	{
+		return e->gue.encapsulate(p, vip, dip, pdip, ts, gen, hash);
+	}
+	
+	static inline WritablePacket *encapsulatePlain(Encapper *e, Packet *p, uint32_t vip, uint32_t dip, uint32_t hash)
+	{
+		return e->gue.encapsulatePlain(p, vip, dip, hash);
+	}
+};
+
+enum EncapKind
+{
+	ENCAP_IPIP,
+	ENCAP_GG,
+	ENCAP_GUE,
+};
+
+/* "IPIP", "GG" or "GUE" */
+static inline bool parseEncapKind(const String &name, EncapKind *kind)
+{
+	if (name == "IPIP")
+		*kind = ENCAP_IPIP;
+	else if (name == "GG")
+		*kind = ENCAP_GG;
+	else if (name == "GUE")
+		*kind = ENCAP_GUE;
+	else
+		return false;
+	return true;
+}
+
+/* whether kind's packets carry the previous DIP, so backends can daisy chain */
+static inline bool encapCarriesMetadata(EncapKind kind)
+{
+	return kind != ENCAP_IPIP;
+}
+
+}
+
+CLICK_ENDDECLS
+
+#endif /* CLICK_BEAMER_ENCAPPER_HH */
@@ -0,0 +1,155 @@
+#include "flowreplicator.hh"
+#include <sys/socket.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+
+CLICK_DECLS
+
+namespace Beamer
+{
+
+FlowReplicator::FlowReplicator()
+	: router(NULL), sock(-1), running(false), sent(0), received(0), rejected(0) {}
+
+FlowReplicator::~FlowReplicator()
+{
+	stop();
+}
+
+int FlowReplicator::start(const Vector<FlowTable *> &tables, const FlowRouter *router, uint16_t port, IPAddress peerAddr, uint16_t peerPort)
+{
+	struct sockaddr_in local;
+	
+	assert(!running);
+	
+	sock = socket(AF_INET, SOCK_DGRAM, 0);
+	if (sock < 0)
+		return -errno;
+	
+	memset(&local, 0, sizeof(local));
+	local.sin_family = AF_INET;
+	local.sin_addr.s_addr = htonl(INADDR_ANY);
+	local.sin_port = htons(port);
+	if (bind(sock, (struct sockaddr *)&local, sizeof(local)) < 0)
+	{
+		int err = -errno;
+		
+		close(sock);
+		sock = -1;
+		return err;
+	}
+	
+	memset(&peer, 0, sizeof(peer));
+	peer.sin_family = AF_INET;
+	peer.sin_addr = peerAddr.in_addr();
+	peer.sin_port = htons(peerPort);
+	
+	this->tables = tables;
+	this->router = router;
+	
+	running = true;
+	int err = pthread_create(&thread, NULL, run, this);
+	if (err != 0)
+	{
+		running = false;
+		close(sock);
+		sock = -1;
+		return -err;
+	}
+	
+	return 0;
+}
+
+void FlowReplicator::stop()
+{
+	if (!running)
+		return;
+	
+	__atomic_store_n(&running, false, __ATOMIC_RELEASE);
+	pthread_join(thread, NULL);
+	
+	close(sock);
+	sock = -1;
+}
+
+void *FlowReplicator::run(void *arg)
+{
+	FlowReplicator *me = (FlowReplicator *)arg;
+	
+	while (__atomic_load_n(&me->running, __ATOMIC_ACQUIRE))
+	{
+		struct pollfd pfd;
+		
+		pfd.fd = me->sock;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		poll(&pfd, 1, POLL_MS);
+		
+		me->receive();
+		me->send();
+	}
+	
+	/* whatever is still journaled */
+	me->send();
+	
+	return NULL;
+}
+
+void FlowReplicator::send()
+{
+	char buf[sizeof(Header) + MAX_RECORDS * sizeof(FlowRecord)];
+	Header *header = (Header *)buf;
+	FlowRecord *records = (FlowRecord *)(header + 1);
+	
+	header->magic = MAGIC;
+	header->version = VERSION;
+	
+	for (int i = 0; i < tables.size(); i++)
+	{
+		int count;
+		
+		while ((count = tables[i]->drainJournal(records, MAX_RECORDS)) > 0)
+		{
+			header->count = count;
+			if (sendto(sock, buf, sizeof(Header) + count * sizeof(FlowRecord), 0, (struct sockaddr *)&peer, sizeof(peer)) >= 0)
+				sent += count;
+		}
+	}
+}
+
+void FlowReplicator::receive()
+{
+	char buf[sizeof(Header) + MAX_RECORDS * sizeof(FlowRecord)];
+	const Header *header = (const Header *)buf;
+	const FlowRecord *records = (const FlowRecord *)(header + 1);
+	struct sockaddr_in from;
+	socklen_t fromLen = sizeof(from);
+	ssize_t len;
+	
+	while ((len = recvfrom(sock, buf, sizeof(buf), MSG_DONTWAIT, (struct sockaddr *)&from, &fromLen)) >= 0)
+	{
+		fromLen = sizeof(from);
+		
+		if (from.sin_addr.s_addr != peer.sin_addr.s_addr ||
+			len < (ssize_t)sizeof(Header) ||
+			header->magic != MAGIC ||
+			header->version != VERSION ||
+			header->count > MAX_RECORDS ||
+			len != (ssize_t)(sizeof(Header) + header->count * sizeof(FlowRecord)))
+		{
+			rejected++;
+			continue;
+		}
+		
+		router->import(records, header->count);
+		received += header->count;
+	}
+}
+
+}
+
+CLICK_ENDDECLS
+
+ELEMENT_PROVIDES(Beamer_FlowReplicator)
+ELEMENT_REQUIRES(Beamer_FlowTable)
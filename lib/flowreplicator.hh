@@ -0,0 +1,103 @@
+#ifndef CLICK_BEAMER_FLOWREPLICATOR_HH
+#define CLICK_BEAMER_FLOWREPLICATOR_HH
+
+#include <click/config.h>
+#include <click/ipaddress.hh>
+#include <click/vector.hh>
+#include <netinet/in.h>
+#include <pthread.h>
+#include "flowtable.hh"
+
+CLICK_DECLS
+
+namespace Beamer
+{
+
+/*
+ * Streams the flows our tables journal to a peer mux over UDP, and puts the
+ * peer's into our tables, so that either mux can take over the other's
+ * connections. Datagrams carry up to MAX_RECORDS FlowRecords behind a small
+ * header, in host byte order; a lost one only means that some flows fall
+ * back to the ring.
+ */
+class FlowReplicator
+{
+	static const uint32_t MAGIC = 0x424d4652;
+	static const uint16_t VERSION = 1;
+	static const int MAX_RECORDS = 64;
+	
+	/* upper bound on how long journaled flows wait to be sent */
+	static const int POLL_MS = 10;
+	
+	struct Header
+	{
+		uint32_t magic;
+		uint16_t version;
+		uint16_t count;
+	} __attribute__((packed));
+	
+	/* journaled by us */
+	Vector<FlowTable *> tables;
+	
+	/* where the peer's go */
+	const FlowRouter *router;
+	
+	int sock;
+	struct sockaddr_in peer;
+	
+	pthread_t thread;
+	volatile bool running;
+	
+	volatile uint64_t sent;
+	volatile uint64_t received;
+	volatile uint64_t rejected;
+	
+	static void *run(void *arg);
+	
+	void send();
+	
+	void receive();
+	
+	FlowReplicator(const FlowReplicator &);
+	FlowReplicator &operator=(const FlowReplicator &);
+	
+public:
+	FlowReplicator();
+	
+	~FlowReplicator();
+	
+	/*
+	 * Listens on port and sends to the peer; the tables must be journaling
+	 * already. router must outlive the replicator, or at least stop().
+	 */
+	int start(const Vector<FlowTable *> &tables, const FlowRouter *router, uint16_t port, IPAddress peerAddr, uint16_t peerPort);
+	
+	void stop();
+	
+	bool isRunning() const
+	{
+		return running;
+	}
+	
+	uint64_t getSent() const
+	{
+		return sent;
+	}
+	
+	uint64_t getReceived() const
+	{
+		return received;
+	}
+	
+	/* datagrams that weren't ours or were malformed */
+	uint64_t getRejected() const
+	{
+		return rejected;
+	}
+};
+
+}
+
+CLICK_ENDDECLS
+
+#endif /* CLICK_BEAMER_FLOWREPLICATOR_HH */
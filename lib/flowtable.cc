@@ -0,0 +1,789 @@
+#include "flowtable.hh"
+#include <stdlib.h>
+
+CLICK_DECLS
+
+namespace Beamer
+{
+
+FlowTable::FlowTable(uint32_t capacity, const Timeouts &timeouts, bool shared)
+	: midstream(false), inboxHead(0), inboxPending(0), inboxDropped(0), shared(shared), stripes(NULL), stripeMask(0)
+{
+	uint32_t count = roundCapacity(capacity) / BUCKET_ENTRIES;
+	
+	mask = count - 1;
+	setTimeouts(timeouts);
+	
+	void *mem;
+	int err = posix_memalign(&mem, 64, count * sizeof(Bucket)); assert(err == 0);
+	buckets = (Bucket *)mem;
+	memset(buckets, 0, count * sizeof(Bucket));
+	
+	due = new uint32_t[count]; assert(due);
+	for (uint32_t i = 0; i < count; i++)
+		due[i] = NOT_DUE;
+	
+	wheelCount = shared ? click_max_cpu_ids() : 1;
+	wheels = new Wheel[wheelCount]; assert(wheels);
+	for (int i = 0; i < wheelCount; i++)
+	{
+		wheels[i].timers = TimerWheel(ticks(click_jiffies()));
+		wheels[i].advanced = ticks(click_jiffies());
+	}
+	swept = ticks(click_jiffies());
+	
+	if (shared)
+	{
+		uint32_t stripeCount = count < MAX_STRIPES ? count : MAX_STRIPES;
+		
+		stripes = new uint32_t[stripeCount]; assert(stripes);
+		memset(stripes, 0, stripeCount * sizeof(uint32_t));
+		stripeMask = stripeCount - 1;
+	}
+	
+	pthread_mutex_init(&inboxLock, NULL);
+	pthread_mutex_init(&flushLock, NULL);
+}
+
+uint32_t FlowTable::roundCapacity(uint32_t capacity)
+{
+	uint32_t count = 1;
+	
+	while (count * BUCKET_ENTRIES < capacity)
+		count <<= 1;
+	return count * BUCKET_ENTRIES;
+}
+
+void FlowTable::setTimeouts(const Timeouts &timeouts)
+{
+	click_jiffies_t jiffies[FLOW_STATE_COUNT];
+	jiffies[FLOW_ESTABLISHED] = timeouts.established;
+	jiffies[FLOW_HALF_OPEN] = timeouts.halfOpen;
+	jiffies[FLOW_CLOSING] = timeouts.closing;
+	
+	for (int i = 0; i < FLOW_STATE_COUNT; i++)
+	{
+		uint32_t timeoutTicks = ticks(jiffies[i]);
+		if (timeoutTicks < 1)
+			timeoutTicks = 1;
+		if (timeoutTicks > MAX_TIMEOUT)
+			timeoutTicks = MAX_TIMEOUT;
+		this->timeouts[i] = timeoutTicks;
+	}
+}
+
+FlowTable::~FlowTable()
+{
+	for (int i = 0; i < wheelCount; i++)
+		delete[] wheels[i].journal;
+	pthread_mutex_destroy(&inboxLock);
+	pthread_mutex_destroy(&flushLock);
+	
+	free(buckets);
+	delete[] due;
+	delete[] wheels;
+	delete[] stripes;
+}
+
+uint64_t FlowTable::expired() const
+{
+	uint64_t ret = 0;
+	
+	for (int i = 0; i < wheelCount; i++)
+		ret += wheels[i].expired;
+	return ret;
+}
+
+uint64_t FlowTable::evicted() const
+{
+	uint64_t ret = 0;
+	
+	for (int i = 0; i < wheelCount; i++)
+		ret += wheels[i].evicted;
+	return ret;
+}
+
+uint64_t FlowTable::refused() const
+{
+	uint64_t ret = 0;
+	
+	for (int i = 0; i < wheelCount; i++)
+		ret += wheels[i].refused;
+	return ret;
+}
+
+uint64_t FlowTable::journalDropped() const
+{
+	uint64_t ret = 0;
+	
+	for (int i = 0; i < wheelCount; i++)
+		ret += wheels[i].journalDropped;
+	return ret;
+}
+
+/* make sure b gets swept by tick; a bucket is only ever on a wheel for its earliest deadline */
+void FlowTable::schedule(Bucket *b, uint32_t tick, Wheel *w)
+{
+	uint32_t index = b - buckets;
+	
+	if (due[index] != NOT_DUE && (int32_t)(due[index] - tick) <= 0)
+		return;
+	
+	due[index] = tick;
+	
+	/* somebody else may be popping timers off w */
+	if (shared)
+		lockWheel(w);
+	w->timers.schedule(index, tick);
+	if (shared)
+		unlockWheel(w);
+}
+
+void FlowTable::sweep(Bucket *b, uint32_t tick, uint32_t now, Wheel *w)
+{
+	uint32_t index = b - buckets;
+	int16_t next = 0x7fff;
+	bool any = false;
+	
+	/* superseded by an earlier deadline, which has been dealt with */
+	if (due[index] != tick)
+		return;
+	due[index] = NOT_DUE;
+	
+	for (int i = 0; i < BUCKET_ENTRIES; i++)
+	{
+		if (!b->sigs[i])
+			continue;
+		
+		int16_t left = b->expiry[i] - (uint16_t)now;
+		
+		if (left <= 0)
+		{
+			journal(w, b->keys[i], b->dips[i], stateOf(b->sigs[i]), 0);
+			b->sigs[i] = 0;
+			w->expired++;
+		}
+		else
+		{
+			any = true;
+			if (left < next)
+				next = left;
+		}
+	}
+	
+	if (any)
+		schedule(b, now + next, w);
+}
+
+void FlowTable::refresh(Bucket *b, int i, int event, uint32_t now, Wheel *w)
+{
+	int state = stateOf(b->sigs[i]);
+	int next = transition(state, event);
+	uint16_t old = b->expiry[i];
+	uint32_t expiry = now + timeouts[next];
+	
+	/* the peer only hears about refreshes every half timeout */
+	if (w->journal && (next != state || (int16_t)(old - (uint16_t)now) < timeouts[state] / 2))
+		journal(w, b->keys[i], b->dips[i], next, timeouts[next]);
+	
+	if (next != state)
+		b->sigs[i] = (b->sigs[i] & SIG_MASK) | (next << STATE_SHIFT);
+	b->expiry[i] = expiry;
+	
+	/* later deadlines are picked up lazily when the bucket comes due */
+	if ((int16_t)((uint16_t)expiry - old) < 0)
+		schedule(b, expiry, w);
+}
+
+/* a slot for a new flow in state, or NULL if there's no room */
+FlowTable::Bucket *FlowTable::claim(Bucket *b1, Bucket *b2, int state, uint32_t now, Wheel *w, int *slot)
+{
+	Bucket *b = b1;
+	uint32_t slots = vacant(b1, now);
+	int i;
+	
+	if (!slots)
+	{
+		b = b2;
+		slots = vacant(b2, now);
+	}
+	
+	if (slots)
+	{
+		i = __builtin_ctz(slots);
+		
+		/* timed out, just not swept yet */
+		if (b->sigs[i])
+			w->expired++;
+	}
+	else /* both full of live flows: evict the one closest to expiry */
+	{
+		Bucket *candidates[2] = { b1, b2 };
+		
+		b = NULL;
+		i = -1;
+		for (int c = 0; c < 2; c++)
+		{
+			for (int j = 0; j < BUCKET_ENTRIES; j++)
+			{
+				/* a SYN flood mustn't push out established flows */
+				if (state == FLOW_HALF_OPEN && stateOf(candidates[c]->sigs[j]) == FLOW_ESTABLISHED)
+					continue;
+				
+				if (!b || (int16_t)(candidates[c]->expiry[j] - b->expiry[i]) < 0)
+				{
+					b = candidates[c];
+					i = j;
+				}
+			}
+		}
+		
+		if (!b)
+		{
+			w->refused++;
+			return NULL;
+		}
+		w->evicted++;
+	}
+	
+	*slot = i;
+	return b;
+}
+
+void FlowTable::put(Bucket *b1, Bucket *b2, uint64_t key, uint16_t sig, uint32_t dip, int event, uint32_t now, Wheel *w)
+{
+	int state = initialState(event);
+	int i;
+	Bucket *b = claim(b1, b2, state, now, w, &i);
+	
+	if (!b)
+		return;
+	
+	uint32_t expiry = now + timeouts[state];
+	
+	b->keys[i] = key;
+	b->dips[i] = dip;
+	b->expiry[i] = expiry;
+	b->sigs[i] = sig | (state << STATE_SHIFT);
+	
+	schedule(b, expiry, w);
+	journal(w, key, dip, state, timeouts[state]);
+}
+
+/* imported flows win over what we have: they come from wherever the flow was seen last */
+void FlowTable::restore(Bucket *b1, Bucket *b2, const FlowRecord &record, uint16_t sig, uint32_t now, Wheel *w)
+{
+	int state = record.state;
+	
+	if (state >= FLOW_STATE_COUNT)
+		state = FLOW_ESTABLISHED;
+	
+	uint32_t remaining = record.remaining < timeouts[state] ? record.remaining : timeouts[state];
+	Bucket *b = b1;
+	int i = find(b1, record.key, sig, now);
+	
+	if (i < 0)
+	{
+		b = b2;
+		i = find(b2, record.key, sig, now);
+	}
+	
+	if (remaining == 0)
+	{
+		if (i >= 0)
+			b->sigs[i] = 0;
+		return;
+	}
+	
+	if (i < 0)
+	{
+		b = claim(b1, b2, state, now, w, &i);
+		if (!b)
+			return;
+		b->keys[i] = record.key;
+	}
+	
+	b->dips[i] = record.dip;
+	b->expiry[i] = now + remaining;
+	b->sigs[i] = sig | (state << STATE_SHIFT);
+	
+	schedule(b, now + remaining, w);
+}
+
+void FlowTable::journal(Wheel *w, uint64_t key, uint32_t dip, int state, uint16_t remaining)
+{
+	if (!w->journal)
+		return;
+	
+	uint32_t tail = w->journalTail;
+	
+	if (tail - __atomic_load_n(&w->journalHead, __ATOMIC_ACQUIRE) >= JOURNAL_SIZE)
+	{
+		w->journalDropped++;
+		return;
+	}
+	
+	FlowRecord *record = &w->journal[tail & (JOURNAL_SIZE - 1)];
+	
+	record->key = key;
+	record->dip = dip;
+	record->remaining = remaining;
+	record->state = state;
+	record->reserved = 0;
+	__atomic_store_n(&w->journalTail, tail + 1, __ATOMIC_RELEASE);
+}
+
+uint32_t FlowTable::update(Bucket *b1, Bucket *b2, uint64_t key, uint16_t sig, uint32_t dip, int event, uint32_t now, Wheel *w)
+{
+	int i;
+	
+	if ((i = find(b1, key, sig, now)) >= 0)
+	{
+		refresh(b1, i, event, now, w);
+		return b1->dips[i];
+	}
+	
+	if ((i = find(b2, key, sig, now)) >= 0)
+	{
+		refresh(b2, i, event, now, w);
+		return b2->dips[i];
+	}
+	
+	if (creates(event))
+		put(b1, b2, key, sig, dip, event, now, w);
+	return dip;
+}
+
+/* lock-free; retries if it raced with a writer */
+FlowTable::ProbeResult FlowTable::probe(const Bucket *b1, const Bucket *b2, uint64_t key, uint16_t sig, int event, uint16_t now, uint32_t *dip) const
+{
+	uint32_t *s1 = stripe(b1);
+	uint32_t *s2 = stripe(b2);
+	ProbeResult ret;
+	uint32_t seq1;
+	uint32_t seq2;
+	
+	do
+	{
+		seq1 = __atomic_load_n(s1, __ATOMIC_ACQUIRE);
+		seq2 = __atomic_load_n(s2, __ATOMIC_ACQUIRE);
+		
+		const Bucket *b = b1;
+		int i = find(b1, key, sig, now);
+		
+		if (i < 0)
+		{
+			b = b2;
+			i = find(b2, key, sig, now);
+		}
+		
+		if (i < 0)
+		{
+			ret = PROBE_MISS;
+		}
+		else
+		{
+			int state = stateOf(b->sigs[i]);
+			
+			*dip = b->dips[i];
+			if (transition(state, event) != state || (uint16_t)(b->expiry[i] - now) < timeouts[state] / 2)
+				ret = PROBE_STALE;
+			else
+				ret = PROBE_HIT;
+		}
+		
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	}
+	while (unlikely(((seq1 | seq2) & 1) || __atomic_load_n(s1, __ATOMIC_RELAXED) != seq1 || __atomic_load_n(s2, __ATOMIC_RELAXED) != seq2));
+	
+	return ret;
+}
+
+uint32_t FlowTable::lockedUpdate(Bucket *b1, Bucket *b2, uint64_t key, uint16_t sig, uint32_t dip, int event, uint32_t now, Wheel *w)
+{
+	uint32_t *s[2];
+	uint32_t seq[2];
+	
+	lockPair(b1, b2, s, seq);
+	
+	/* somebody else may have inserted the flow since we looked */
+	dip = update(b1, b2, key, sig, dip, event, now, w);
+	
+	unlockPair(s, seq);
+	
+	return dip;
+}
+
+uint32_t FlowTable::lookupInsert(uint64_t key, uint32_t hash, uint32_t dip, int event, uint32_t now, unsigned int cpuID)
+{
+	uint16_t sig = signature(hash);
+	Bucket *b1 = primary(hash);
+	Bucket *b2 = secondary(hash);
+	
+	catchUp(now, wheel(cpuID));
+	
+	if (!shared)
+		return update(b1, b2, key, sig, dip, event, now, wheel(cpuID));
+	
+	uint32_t found;
+	ProbeResult result = probe(b1, b2, key, sig, event, now, &found);
+	
+	if (result == PROBE_HIT)
+		return found;
+	if (result == PROBE_MISS && !creates(event))
+		return dip;
+	return lockedUpdate(b1, b2, key, sig, dip, event, now, wheel(cpuID));
+}
+
+void FlowTable::lookupInsertBatch(const uint64_t *keys, const uint32_t *hashes, uint32_t *dips, const uint8_t *events, int count, uint32_t now, unsigned int cpuID)
+{
+	assert(count <= MAX_BATCH);
+	
+	catchUp(now, wheel(cpuID));
+	
+	/* signatures are in the first line; pull in the key lines we're going to compare */
+	for (int i = 0; i < count; i++)
+	{
+		uint16_t sig = signature(hashes[i]);
+		const Bucket *b1 = primary(hashes[i]);
+		const Bucket *b2 = secondary(hashes[i]);
+		
+		if (match(b1, sig))
+			__builtin_prefetch(b1->keys);
+		if (match(b2, sig))
+			__builtin_prefetch(b2->keys);
+	}
+	
+	if (!shared)
+	{
+		/* in order, so repeats of a new flow within the batch find its first packet's entry */
+		for (int i = 0; i < count; i++)
+			dips[i] = update(primary(hashes[i]), secondary(hashes[i]), keys[i], signature(hashes[i]), dips[i], events[i], now, wheel(cpuID));
+		return;
+	}
+	
+	/* this core's insert buffer: whatever needs the lock waits until all lookups are done */
+	int pending[MAX_BATCH];
+	int pendingCount = 0;
+	
+	for (int i = 0; i < count; i++)
+	{
+		uint32_t found;
+		ProbeResult result = probe(primary(hashes[i]), secondary(hashes[i]), keys[i], signature(hashes[i]), events[i], now, &found);
+		
+		if (result == PROBE_HIT)
+			dips[i] = found;
+		else if (result == PROBE_STALE || creates(events[i]))
+			pending[pendingCount++] = i;
+	}
+	
+	for (int j = 0; j < pendingCount; j++)
+	{
+		int i = pending[j];
+		
+		dips[i] = lockedUpdate(primary(hashes[i]), secondary(hashes[i]), keys[i], signature(hashes[i]), dips[i], events[i], now, wheel(cpuID));
+	}
+}
+
+/* buckets that came due on from; whatever they still hold goes back on to */
+void FlowTable::sweepDue(Wheel *from, uint32_t now, Wheel *to)
+{
+	TimerWheel::Timer timers[EXPIRE_BUDGET];
+	bool behind;
+	
+	do
+	{
+		/* whoever has it is advancing it already */
+		if (shared && !tryLockWheel(from))
+			return;
+		
+		int count = from->timers.advance(now, timers, EXPIRE_BUDGET);
+		behind = from->timers.behind(now) >= CATCHUP_LAG;
+		__atomic_store_n(&from->advanced, now, __ATOMIC_RELAXED);
+		
+		if (shared)
+			unlockWheel(from);
+		
+		for (int i = 0; i < count; i++)
+		{
+			Bucket *b = &buckets[timers[i].id];
+			
+			if (!shared)
+			{
+				sweep(b, timers[i].tick, now, to);
+				continue;
+			}
+			
+			uint32_t *s = stripe(b);
+			uint32_t seq = lock(s);
+			
+			sweep(b, timers[i].tick, now, to);
+			unlock(s, seq);
+		}
+	}
+	while (behind);
+}
+
+/* empties the table; the wheels' timers for it find nothing due when they fire */
+void FlowTable::flush(uint32_t now, Wheel *w)
+{
+	pthread_mutex_lock(&flushLock);
+	
+	/* somebody else got here first */
+	if (!stale(now))
+	{
+		pthread_mutex_unlock(&flushLock);
+		return;
+	}
+	
+	for (uint32_t i = 0; i <= mask; i++)
+	{
+		Bucket *b = &buckets[i];
+		uint32_t *s = shared ? stripe(b) : NULL;
+		uint32_t seq = s ? lock(s) : 0;
+		
+		for (int j = 0; j < BUCKET_ENTRIES; j++)
+		{
+			if (!b->sigs[j])
+				continue;
+			b->sigs[j] = 0;
+			w->expired++;
+		}
+		due[i] = NOT_DUE;
+		
+		if (s)
+			unlock(s, seq);
+	}
+	
+	__atomic_store_n(&swept, now, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&flushLock);
+}
+
+void FlowTable::expire(uint32_t now, unsigned int cpuID)
+{
+	Wheel *w = wheel(cpuID);
+	
+	catchUp(now, w);
+	sweepDue(w, now, w);
+	
+	/* one other wheel per call; a stalled one's buckets move over to ours */
+	if (shared)
+	{
+		Wheel *other = &wheels[w->helpNext];
+		
+		w->helpNext = (w->helpNext + 1) % wheelCount;
+		if (other != w && (int32_t)(now - __atomic_load_n(&other->advanced, __ATOMIC_RELAXED)) > (int32_t)STALL_TICKS)
+			sweepDue(other, now, w);
+	}
+	
+	if (__atomic_load_n(&swept, __ATOMIC_RELAXED) != now)
+		__atomic_store_n(&swept, now, __ATOMIC_RELEASE);
+	
+	drainInbox(now, w);
+}
+
+void FlowTable::drainInbox(uint32_t now, Wheel *w)
+{
+	if (!__atomic_load_n(&inboxPending, __ATOMIC_ACQUIRE))
+		return;
+	
+	/* somebody's at it already, or an import is being queued */
+	if (pthread_mutex_trylock(&inboxLock) != 0)
+		return;
+	
+	int end = inboxHead + IMPORT_BUDGET < inbox.size() ? inboxHead + IMPORT_BUDGET : inbox.size();
+	
+	for (; inboxHead < end; inboxHead++)
+	{
+		const Import &import = inbox[inboxHead];
+		Bucket *b1 = primary(import.hash);
+		Bucket *b2 = secondary(import.hash);
+		
+		if (!shared)
+		{
+			restore(b1, b2, import.record, signature(import.hash), now, w);
+			continue;
+		}
+		
+		uint32_t *s[2];
+		uint32_t seq[2];
+		
+		lockPair(b1, b2, s, seq);
+		restore(b1, b2, import.record, signature(import.hash), now, w);
+		unlockPair(s, seq);
+	}
+	
+	if (inboxHead == inbox.size())
+	{
+		inbox.clear();
+		inboxHead = 0;
+	}
+	__atomic_store_n(&inboxPending, inbox.size() - inboxHead, __ATOMIC_RELEASE);
+	
+	pthread_mutex_unlock(&inboxLock);
+}
+
+void FlowTable::import(const FlowRecord *records, const uint32_t *hashes, int count)
+{
+	pthread_mutex_lock(&inboxLock);
+	
+	for (int i = 0; i < count; i++)
+	{
+		Import import;
+		
+		if (inbox.size() - inboxHead >= (int)capacity())
+		{
+			inboxDropped += count - i;
+			break;
+		}
+		
+		import.record = records[i];
+		import.hash = hashes[i];
+		inbox.push_back(import);
+	}
+	__atomic_store_n(&inboxPending, inbox.size() - inboxHead, __ATOMIC_RELEASE);
+	
+	pthread_mutex_unlock(&inboxLock);
+}
+
+/* a consistent copy of b, even while it's being written to */
+void FlowTable::read(const Bucket *b, Bucket *copy) const
+{
+	if (shared)
+	{
+		uint32_t *s = stripe(b);
+		uint32_t seq;
+		
+		do
+		{
+			seq = __atomic_load_n(s, __ATOMIC_ACQUIRE);
+			memcpy(copy, b, sizeof(Bucket));
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		}
+		while ((seq & 1) || __atomic_load_n(s, __ATOMIC_RELAXED) != seq);
+		return;
+	}
+	
+	/* the owning CPU doesn't lock: settle for two identical reads in a row */
+	memcpy(copy, b, sizeof(Bucket));
+	for (int tries = 0; tries < 8; tries++)
+	{
+		Bucket again;
+		
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		memcpy(&again, b, sizeof(Bucket));
+		if (memcmp(copy, &again, sizeof(Bucket)) == 0)
+			return;
+		memcpy(copy, &again, sizeof(Bucket));
+	}
+}
+
+void FlowTable::snapshot(Vector<FlowRecord> *records, uint32_t now) const
+{
+	/* nothing live, and expiry times can't be trusted */
+	if (stale(now))
+		return;
+	
+	for (uint32_t i = 0; i <= mask; i++)
+	{
+		Bucket b;
+		
+		read(&buckets[i], &b);
+		for (int j = 0; j < BUCKET_ENTRIES; j++)
+		{
+			if (!b.sigs[j] || !live(&b, j, now))
+				continue;
+			
+			FlowRecord record;
+			
+			record.key = b.keys[j];
+			record.dip = b.dips[j];
+			record.remaining = b.expiry[j] - (uint16_t)now;
+			record.state = stateOf(b.sigs[j]);
+			record.reserved = 0;
+			records->push_back(record);
+		}
+	}
+}
+
+void FlowTable::setJournal(bool enable)
+{
+	for (int i = 0; i < wheelCount; i++)
+	{
+		if (enable && !wheels[i].journal)
+		{
+			wheels[i].journal = new FlowRecord[JOURNAL_SIZE]; assert(wheels[i].journal);
+		}
+		else if (!enable)
+		{
+			delete[] wheels[i].journal;
+			wheels[i].journal = NULL;
+		}
+	}
+}
+
+int FlowTable::drainJournal(FlowRecord *records, int max)
+{
+	int count = 0;
+	
+	for (int i = 0; i < wheelCount && count < max; i++)
+	{
+		Wheel *w = &wheels[i];
+		
+		if (!w->journal)
+			continue;
+		
+		uint32_t head = w->journalHead;
+		uint32_t tail = __atomic_load_n(&w->journalTail, __ATOMIC_ACQUIRE);
+		
+		while (head != tail && count < max)
+			records[count++] = w->journal[head++ & (JOURNAL_SIZE - 1)];
+		__atomic_store_n(&w->journalHead, head, __ATOMIC_RELEASE);
+	}
+	
+	return count;
+}
+
+void FlowRouter::import(const FlowRecord *records, int count) const
+{
+	uint32_t mask = routes.size() - 1;
+	Vector<FlowTable *> targets;
+	Vector<uint32_t> hashes;
+	Vector<FlowRecord> batch;
+	Vector<uint32_t> batchHashes;
+	
+	for (int i = 0; i < count; i++)
+	{
+		uint32_t ringHash = hash(records[i].key);
+		
+		targets.push_back(routes[ringHash & mask]);
+		hashes.push_back(FlowTable::hash(ringHash, (uint16_t)records[i].key));
+	}
+	
+	/* a table at a time; done ones are crossed out */
+	for (int i = 0; i < count; i++)
+	{
+		FlowTable *table = targets[i];
+		
+		if (!table)
+			continue;
+		
+		batch.clear();
+		batchHashes.clear();
+		for (int j = i; j < count; j++)
+		{
+			if (targets[j] != table)
+				continue;
+			batch.push_back(records[j]);
+			batchHashes.push_back(hashes[j]);
+			targets[j] = NULL;
+		}
+		table->import(batch.begin(), batchHashes.begin(), batch.size());
+	}
+}
+
+}
+
+CLICK_ENDDECLS
+
+ELEMENT_PROVIDES(Beamer_FlowTable)
@@ -0,0 +1,604 @@
+#ifndef CLICK_BEAMER_FLOWTABLE_HH
+#define CLICK_BEAMER_FLOWTABLE_HH
+
+#include <click/config.h>
+#include <click/glue.hh>
+#include <click/vector.hh>
+#include <clicknet/tcp.h>
+#include <pthread.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "timerwheel.hh"
+
+CLICK_DECLS
+
+namespace Beamer
+{
+
+/* one flow, as exported, imported and replicated */
+struct FlowRecord
+{
+	uint64_t key;
+	uint32_t dip;
+	uint16_t remaining; /* in FlowTable ticks; 0 = the flow is gone */
+	uint8_t state;
+	uint8_t reserved;
+} __attribute__((packed));
+
+/*
+ * Per-CPU connection table: flow key -> DIP. Each flow has two candidate
+ * buckets of 8 entries; 14-bit signatures are compared 8 at a time and
+ * full keys are only read on a signature match. Expiry times are kept in
+ * coarse 16-bit ticks right next to the signatures, and the top two bits
+ * of each signature hold the connection's state, which picks its timeout.
+ * Flows are only created by SYNs (and, if allowed, by mid-stream packets),
+ * and a full bucket never gives up an established flow for a half-open one.
+ *
+ * Buckets holding flows sit on a timer wheel, due at their earliest
+ * expiry. Refreshing a flow doesn't touch the wheel: when a bucket comes
+ * due, expired flows are dropped and the bucket is put back for whatever
+ * is left. expire() does this a few buckets at a time.
+ *
+ * A table can also be shared by all CPUs, for when flows aren't pinned to
+ * cores. Buckets are then guarded by striped seqlocks: lookups never write,
+ * hits only refresh once half the timeout has passed, and inserts are held
+ * back until the end of a batch. Each CPU schedules buckets on a timer
+ * wheel of its own, but any CPU advances a wheel that has stopped moving
+ * (its CPU lost its traffic to RSS, or went idle) and takes over the
+ * buckets that come due on it.
+ *
+ * Flows can be exported, imported (handed over to whichever CPU calls
+ * expire() next) and journaled for replication as they come and go.
+ */
+class FlowTable
+{
+public:
+	static const int BUCKET_ENTRIES = 8;
+	
+	/* expiry granularity */
+	static const int TICK_HZ = 16;
+	
+	enum FlowState
+	{
+		FLOW_ESTABLISHED,
+		FLOW_HALF_OPEN,
+		FLOW_CLOSING,
+		FLOW_STATE_COUNT,
+	};
+	
+	/* what a packet says about its connection */
+	enum Event
+	{
+		EVENT_DATA,
+		EVENT_SYN,
+		EVENT_CLOSE,
+	};
+	
+	/* per FlowState, in jiffies */
+	struct Timeouts
+	{
+		click_jiffies_t established;
+		click_jiffies_t halfOpen;
+		click_jiffies_t closing;
+	};
+	
+	/*
+	 * Longest timeout, in ticks. Expiry is compared as a signed 16-bit
+	 * difference, so a flow must be swept within 0x8000 ticks of timing
+	 * out; this leaves the rest of that for sweeping to catch up.
+	 */
+	static const uint32_t MAX_TIMEOUT = 0x3fff;
+	
+	/* flows per lookupInsertBatch() call */
+	static const int MAX_BATCH = 64;
+	
+	/* buckets looked at per expire() call */
+	static const int EXPIRE_BUDGET = 16;
+	
+	/* how long a wheel may go without advancing before other CPUs take over, in ticks */
+	static const uint32_t STALL_TICKS = TICK_HZ;
+	
+	/* imported flows put in per expire() call */
+	static const int IMPORT_BUDGET = 256;
+	
+	static const uint32_t SNAPSHOT_MAGIC = 0x424d464c;
+	static const uint16_t SNAPSHOT_VERSION = 1;
+	
+	/* followed by count FlowRecords */
+	struct SnapshotHeader
+	{
+		uint32_t magic;
+		uint16_t version;
+		uint16_t recordSize;
+		uint32_t count;
+	} __attribute__((packed));
+	
+private:
+	static const uint16_t SIG_MASK = 0x3fff;
+	static const int STATE_SHIFT = 14;
+	
+	/*
+	 * Two cache lines: signatures, DIPs and expiry times first, so a miss
+	 * touches only one line per bucket; full keys second.
+	 */
+	struct Bucket
+	{
+		uint16_t sigs[BUCKET_ENTRIES]; /* 0 = empty */
+		uint32_t dips[BUCKET_ENTRIES];
+		uint16_t expiry[BUCKET_ENTRIES];
+		uint64_t keys[BUCKET_ENTRIES];
+	} __attribute__((aligned(64)));
+	
+	static const uint32_t JOURNAL_SIZE = 4096;
+	
+	struct Wheel
+	{
+		TimerWheel timers;
+		uint64_t expired;
+		uint64_t evicted;
+		uint64_t refused;
+		
+		/* what this CPU did to flows, for replication; single producer, single consumer */
+		FlowRecord *journal;
+		uint32_t journalHead;
+		uint32_t journalTail;
+		uint64_t journalDropped;
+		
+		/* shared mode: held while timers are scheduled or popped, by any CPU */
+		uint32_t busy;
+		
+		/* the tick timers were last popped at */
+		uint32_t advanced;
+		
+		/* the wheel this CPU looks at next for one that has stalled */
+		int helpNext;
+		
+		Wheel()
+			: expired(0), evicted(0), refused(0), journal(NULL), journalHead(0), journalTail(0), journalDropped(0), busy(0), advanced(0), helpNext(0) {}
+	};
+	
+	struct Import
+	{
+		FlowRecord record;
+		uint32_t hash;
+	};
+	
+	static const uint32_t NOT_DUE = 0xffffffff;
+	
+	/* a wheel this far behind gets caught up at once, whatever the budget */
+	static const uint32_t CATCHUP_LAG = 0x1000;
+	
+	/* a table that nobody has expired for this long only holds dead flows */
+	static const uint32_t SWEEP_HORIZON = 0x4000;
+	
+	Bucket *buckets;
+	uint32_t mask;
+	uint16_t timeouts[FLOW_STATE_COUNT]; /* in ticks */
+	
+	/* the tick each bucket is on a timer wheel for */
+	uint32_t *due;
+	
+	/* one, or one per CPU if shared */
+	Wheel *wheels;
+	int wheelCount;
+	
+	/* the tick expire() last ran at, with the wheels no more than CATCHUP_LAG behind */
+	uint32_t swept;
+	pthread_mutex_t flushLock;
+	
+	/* shared mode only; each counter is odd while a writer is busy */
+	static const uint32_t MAX_STRIPES = 4096;
+	
+	/* whether packets other than SYNs may create flows */
+	bool midstream;
+	
+	/* imported flows that no CPU has put in yet; never more than the table holds */
+	pthread_mutex_t inboxLock;
+	Vector<Import> inbox;
+	int inboxHead;
+	int inboxPending;
+	uint64_t inboxDropped;
+	
+	bool shared;
+	uint32_t *stripes;
+	uint32_t stripeMask;
+	
+	enum ProbeResult
+	{
+		PROBE_MISS,
+		PROBE_HIT,
+		PROBE_STALE, /* hit, but needs writing to */
+	};
+	
+	static inline uint16_t signature(uint32_t hash)
+	{
+		uint16_t sig = (hash >> 18) & SIG_MASK;
+		
+		return sig ? sig : 1;
+	}
+	
+	static inline int stateOf(uint16_t sig)
+	{
+		return sig >> STATE_SHIFT;
+	}
+	
+	static inline int initialState(int event)
+	{
+		switch (event)
+		{
+		case EVENT_SYN:
+			return FLOW_HALF_OPEN;
+		case EVENT_CLOSE:
+			return FLOW_CLOSING;
+		default:
+			return FLOW_ESTABLISHED;
+		}
+	}
+	
+	static inline int transition(int state, int event)
+	{
+		if (event == EVENT_CLOSE)
+			return FLOW_CLOSING;
+		if (event == EVENT_DATA && state == FLOW_HALF_OPEN)
+			return FLOW_ESTABLISHED;
+		return state;
+	}
+	
+	Bucket *primary(uint32_t hash) const
+	{
+		return &buckets[hash & mask];
+	}
+	
+	Bucket *secondary(uint32_t hash) const
+	{
+		return &buckets[(hash ^ (signature(hash) * 0x5bd1e995)) & mask];
+	}
+	
+	Wheel *wheel(unsigned int cpuID) const
+	{
+		return &wheels[shared ? cpuID : 0];
+	}
+	
+	static inline bool live(const Bucket *b, int i, uint16_t now)
+	{
+		return (int16_t)(b->expiry[i] - now) > 0;
+	}
+	
+	/* bit i set if entry i's signature is sig */
+	static inline uint32_t match(const Bucket *b, uint16_t sig)
+	{
+#ifdef __SSE2__
+		__m128i sigs = _mm_and_si128(_mm_load_si128((const __m128i *)b->sigs), _mm_set1_epi16(SIG_MASK));
+		__m128i eq = _mm_cmpeq_epi16(sigs, _mm_set1_epi16(sig));
+		
+		return _mm_movemask_epi8(_mm_packs_epi16(eq, _mm_setzero_si128()));
+#else
+		uint32_t ret = 0;
+		
+		for (int i = 0; i < BUCKET_ENTRIES; i++)
+			ret |= ((b->sigs[i] & SIG_MASK) == sig) << i;
+		return ret;
+#endif
+	}
+	
+	/* bit i set if entry i is empty or expired */
+	static inline uint32_t vacant(const Bucket *b, uint16_t now)
+	{
+#ifdef __SSE2__
+		__m128i empty = _mm_cmpeq_epi16(_mm_load_si128((const __m128i *)b->sigs), _mm_setzero_si128());
+		__m128i left = _mm_sub_epi16(_mm_load_si128((const __m128i *)b->expiry), _mm_set1_epi16(now));
+		__m128i expired = _mm_cmplt_epi16(left, _mm_set1_epi16(1));
+		
+		return _mm_movemask_epi8(_mm_packs_epi16(_mm_or_si128(empty, expired), _mm_setzero_si128()));
+#else
+		uint32_t ret = 0;
+		
+		for (int i = 0; i < BUCKET_ENTRIES; i++)
+			ret |= (b->sigs[i] == 0 || !live(b, i, now)) << i;
+		return ret;
+#endif
+	}
+	
+	static inline int find(const Bucket *b, uint64_t key, uint16_t sig, uint16_t now)
+	{
+		uint32_t candidates = match(b, sig);
+		
+		while (candidates)
+		{
+			int i = __builtin_ctz(candidates);
+			
+			if (b->keys[i] == key && live(b, i, now))
+				return i;
+			candidates &= candidates - 1;
+		}
+		
+		return -1;
+	}
+	
+	void schedule(Bucket *b, uint32_t tick, Wheel *w);
+	
+	void sweep(Bucket *b, uint32_t tick, uint32_t now, Wheel *w);
+	
+	void sweepDue(Wheel *from, uint32_t now, Wheel *to);
+	
+	void flush(uint32_t now, Wheel *w);
+	
+	bool stale(uint32_t now) const
+	{
+		return (int32_t)(now - __atomic_load_n(&swept, __ATOMIC_ACQUIRE)) >= (int32_t)SWEEP_HORIZON;
+	}
+	
+	/*
+	 * Past SWEEP_HORIZON, expiry times that weren't swept could pass for
+	 * future ones; they're all over anyway, so drop them before any lookup.
+	 */
+	void catchUp(uint32_t now, Wheel *w)
+	{
+		if (unlikely(stale(now)))
+			flush(now, w);
+	}
+	
+	void refresh(Bucket *b, int i, int event, uint32_t now, Wheel *w);
+	
+	Bucket *claim(Bucket *b1, Bucket *b2, int state, uint32_t now, Wheel *w, int *slot);
+	
+	void put(Bucket *b1, Bucket *b2, uint64_t key, uint16_t sig, uint32_t dip, int event, uint32_t now, Wheel *w);
+	
+	void restore(Bucket *b1, Bucket *b2, const FlowRecord &record, uint16_t sig, uint32_t now, Wheel *w);
+	
+	void journal(Wheel *w, uint64_t key, uint32_t dip, int state, uint16_t remaining);
+	
+	void drainInbox(uint32_t now, Wheel *w);
+	
+	void read(const Bucket *b, Bucket *copy) const;
+	
+	uint32_t update(Bucket *b1, Bucket *b2, uint64_t key, uint16_t sig, uint32_t dip, int event, uint32_t now, Wheel *w);
+	
+	uint32_t *stripe(const Bucket *b) const
+	{
+		return &stripes[(b - buckets) & stripeMask];
+	}
+	
+	static uint32_t lock(uint32_t *stripe)
+	{
+		uint32_t seq;
+		
+		do
+		{
+			seq = __atomic_load_n(stripe, __ATOMIC_RELAXED) & ~1U;
+		}
+		while (!__atomic_compare_exchange_n(stripe, &seq, seq + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED));
+		
+		return seq;
+	}
+	
+	static void unlock(uint32_t *stripe, uint32_t seq)
+	{
+		__atomic_store_n(stripe, seq + 2, __ATOMIC_RELEASE);
+	}
+	
+	/* wheels are only ever locked inside a bucket's stripe, never the other way around */
+	static bool tryLockWheel(Wheel *w)
+	{
+		return !__atomic_exchange_n(&w->busy, 1, __ATOMIC_ACQUIRE);
+	}
+	
+	static void lockWheel(Wheel *w)
+	{
+		while (!tryLockWheel(w))
+			;
+	}
+	
+	static void unlockWheel(Wheel *w)
+	{
+		__atomic_store_n(&w->busy, 0, __ATOMIC_RELEASE);
+	}
+	
+	/* both buckets' stripes, always in the same order so that two writers can't deadlock */
+	void lockPair(const Bucket *b1, const Bucket *b2, uint32_t **s, uint32_t *seq)
+	{
+		s[0] = stripe(b1);
+		s[1] = stripe(b2);
+		if (s[0] > s[1])
+		{
+			uint32_t *tmp = s[0];
+			s[0] = s[1];
+			s[1] = tmp;
+		}
+		
+		seq[0] = lock(s[0]);
+		seq[1] = s[0] != s[1] ? lock(s[1]) : 0;
+	}
+	
+	static void unlockPair(uint32_t **s, uint32_t *seq)
+	{
+		if (s[0] != s[1])
+			unlock(s[1], seq[1]);
+		unlock(s[0], seq[0]);
+	}
+	
+	ProbeResult probe(const Bucket *b1, const Bucket *b2, uint64_t key, uint16_t sig, int event, uint16_t now, uint32_t *dip) const;
+	
+	uint32_t lockedUpdate(Bucket *b1, Bucket *b2, uint64_t key, uint16_t sig, uint32_t dip, int event, uint32_t now, Wheel *w);
+	
+	FlowTable(const FlowTable &);
+	FlowTable &operator=(const FlowTable &);
+	
+public:
+	/* capacity is rounded up to a power of 2 worth of buckets */
+	FlowTable(uint32_t capacity, const Timeouts &timeouts, bool shared = false);
+	
+	~FlowTable();
+	
+	/* flows to the VIP: addresses and ports as found in the packet */
+	static inline uint64_t key(uint32_t saddr, uint16_t sport, uint16_t dport)
+	{
+		return ((uint64_t)saddr << 32) | ((uint32_t)sport << 16) | dport;
+	}
+	
+	/* reuses beamerHash(), which doesn't always cover the destination port */
+	static inline uint32_t hash(uint32_t ringHash, uint16_t dport)
+	{
+		uint32_t h = ringHash ^ (dport * 0x9e3779b1);
+		
+		h ^= h >> 15;
+		h *= 0x2c1b3c6d;
+		h ^= h >> 12;
+		return h;
+	}
+	
+	static inline int event(const click_tcp *tcpHeader)
+	{
+		if (tcpHeader->th_flags & (TH_FIN | TH_RST))
+			return EVENT_CLOSE;
+		if ((tcpHeader->th_flags & (TH_SYN | TH_ACK)) == TH_SYN)
+			return EVENT_SYN;
+		return EVENT_DATA;
+	}
+	
+	static inline uint32_t ticks(click_jiffies_t jiffies)
+	{
+		return jiffies / (CLICK_HZ / TICK_HZ);
+	}
+	
+	uint32_t capacity() const
+	{
+		return (mask + 1) * BUCKET_ENTRIES;
+	}
+	
+	/* what capacity() a table asked for capacity ends up with */
+	static uint32_t roundCapacity(uint32_t capacity);
+	
+	bool isShared() const
+	{
+		return shared;
+	}
+	
+	void setMidstream(bool midstream)
+	{
+		this->midstream = midstream;
+	}
+	
+	/* flows already in keep their expiry times */
+	void setTimeouts(const Timeouts &timeouts);
+	
+	/* FINs and RSTs never do: the connection is on its way out anyway */
+	bool creates(int event) const
+	{
+		return event == EVENT_SYN || (event == EVENT_DATA && midstream);
+	}
+	
+	/* flows dropped for having timed out */
+	uint64_t expired() const;
+	
+	/* live flows pushed out by new ones */
+	uint64_t evicted() const;
+	
+	/* new flows not inserted for lack of room */
+	uint64_t refused() const;
+	
+	void prefetch(uint32_t hash) const
+	{
+		__builtin_prefetch(primary(hash));
+		__builtin_prefetch(secondary(hash));
+	}
+	
+	/*
+	 * Returns the flow's DIP and refreshes it. A new flow is inserted with
+	 * dip if event creates() it; otherwise dip is just handed back.
+	 */
+	uint32_t lookupInsert(uint64_t key, uint32_t hash, uint32_t dip, int event, uint32_t now, unsigned int cpuID = 0);
+	
+	/*
+	 * Same, for count flows. dips[i] goes in holding the DIP for a new flow
+	 * and comes out holding the flow's DIP (or unchanged, for misses that
+	 * don't create a flow). count is at most MAX_BATCH. Works best if the
+	 * buckets were prefetch()ed a little earlier.
+	 */
+	void lookupInsertBatch(const uint64_t *keys, const uint32_t *hashes, uint32_t *dips, const uint8_t *events, int count, uint32_t now, unsigned int cpuID = 0);
+	
+	/*
+	 * Drop expired flows from at most EXPIRE_BUDGET buckets that came due
+	 * on cpuID's wheel (and as many again from a stalled wheel, if shared),
+	 * unless the wheel fell CATCHUP_LAG behind, and put in up to
+	 * IMPORT_BUDGET imported flows. Expects to be called at least every
+	 * SWEEP_HORIZON ticks while the table is in use.
+	 */
+	void expire(uint32_t now, unsigned int cpuID = 0);
+	
+	/* append the live flows; safe while the table is in use */
+	void snapshot(Vector<FlowRecord> *records, uint32_t now) const;
+	
+	/*
+	 * Queue flows to be put in (or removed, if remaining is 0); from any
+	 * thread. Whatever doesn't fit in a table's worth of queued flows is
+	 * dropped.
+	 */
+	void import(const FlowRecord *records, const uint32_t *hashes, int count);
+	
+	/* imported flows dropped for want of room in the queue */
+	uint64_t importDropped() const
+	{
+		return inboxDropped;
+	}
+	
+	/* start journaling new, refreshed and expired flows; before the table is in use */
+	void setJournal(bool enable);
+	
+	bool journaling() const
+	{
+		return wheels[0].journal != NULL;
+	}
+	
+	/* take up to max journaled records; one consumer only */
+	int drainJournal(FlowRecord *records, int max);
+	
+	/* records lost because the consumer fell behind */
+	uint64_t journalDropped() const;
+};
+
+/*
+ * Sends imported and replicated flows to the one table that is going to
+ * see them: a shared table, or the table of the CPU that RSS steers the
+ * flow to, by the low bits of its ring hash. Per-CPU tables can't take
+ * every flow each; they only hold their share.
+ */
+class FlowRouter
+{
+public:
+	/* a flow's ring hash, from its key */
+	typedef uint32_t (*HashFunction)(uint64_t key);
+	
+private:
+	/* by the low bits of the ring hash; a power of 2 many */
+	Vector<FlowTable *> routes;
+	HashFunction hash;
+	
+public:
+	FlowRouter()
+		: hash(NULL) {}
+	
+	FlowRouter(const Vector<FlowTable *> &routes, HashFunction hash)
+		: routes(routes), hash(hash) {}
+	
+	void set(const Vector<FlowTable *> &routes, HashFunction hash)
+	{
+		this->routes = routes;
+		this->hash = hash;
+	}
+	
+	bool isSet() const
+	{
+		return routes.size() != 0;
+	}
+	
+	/* queue records up on their tables, with one import() per table */
+	void import(const FlowRecord *records, int count) const;
+};
+
+}
+
+CLICK_ENDDECLS
+
+#endif /* CLICK_BEAMER_FLOWTABLE_HH */
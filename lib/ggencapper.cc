@@ -22,32 +22,31 @@ GGEncapper::GGEncapper()
 	iphPDip.opt.num = 1; /* could be anything */
 	iphPDip.opt.len = sizeof(iphPDip.opt);
 #if HAVE_FAST_CHECKSUM
-	iphKey.iph.ip_sum = ip_fast_csum((unsigned char *)&iphPDip, sizeof(iphPDip));
+	iphPDip.iph.ip_sum = ip_fast_csum((unsigned char *)&iphPDip, sizeof(iphPDip));
 #else
 	iphPDip.iph.ip_sum = click_in_cksum((unsigned char *)&iphPDip, sizeof(iphPDip));
 #endif
+	
+	memset(&iphPlain, 0, sizeof(iphPlain));
+	iphPlain.ip_v = 4;
+	iphPlain.ip_hl = sizeof(iphPlain) >> 2;
+	iphPlain.ip_ttl = 250;
+	iphPlain.ip_p = IPPROTO_IPIP;
+#if HAVE_FAST_CHECKSUM
+	iphPlain.ip_sum = ip_fast_csum((unsigned char *)&iphPlain, sizeof(iphPlain));
+#else
+	iphPlain.ip_sum = click_in_cksum((unsigned char *)&iphPlain, sizeof(iphPlain));
+#endif
+	
+	cache.reset(this);
 }
 
-WritablePacket *GGEncapper::encapsulate(Packet *p, uint32_t vip, uint32_t dip, uint32_t pdip, uint32_t ts, uint32_t gen)
+void GGEncapper::build(IPHeaderWithPrevDIP *ip, uint32_t vip, uint32_t dip, uint32_t pdip, uint32_t ts, uint32_t gen)
 {
-	size_t displaceLen = p->end_data() - p->network_header();
-	size_t displaceDWords = displaceLen / 8 + (displaceLen % 8 ? 1 : 0);
-	WritablePacket *wp = p->put(sizeof(IPHeaderWithPrevDIP));
-	size_t oldIPLen = ntohs(wp->ip_header()->ip_len);
-	
-	if (!wp)
-		return 0;
-	
-	/* make room */
-	moveMemBulk(reinterpret_cast<uint64_t *>(wp->network_header()), reinterpret_cast<uint64_t *>(wp->network_header() + sizeof(IPHeaderWithPrevDIP)), displaceDWords);
-	
-	IPHeaderWithPrevDIP *ip = reinterpret_cast<IPHeaderWithPrevDIP *>(wp->ip_header());
-	
-	memcpyFast(reinterpret_cast<unsigned char *>(ip), reinterpret_cast<unsigned char *>(&iphPDip), sizeof(IPHeaderWithPrevDIP));
+	memcpy(ip, &iphPDip, sizeof(IPHeaderWithPrevDIP));
 	
 	ip->iph.ip_src.s_addr = vip;
 	ip->iph.ip_dst.s_addr = dip;
-	ip->iph.ip_len = htons(oldIPLen + sizeof(IPHeaderWithPrevDIP));
 	ip->opt.pdip = pdip;
 	ip->opt.ts = ts;
 	ip->opt.gen = gen;
@@ -55,17 +54,66 @@ WritablePacket *GGEncapper::encapsulate(Packet *p, uint32_t vip, uint32_t dip, u
 	ip->iph.ip_sum = checksumFold(
 		checksumFixup32(0, vip,
 		checksumFixup32(0, dip,
-		checksumFixup16(0, ip->iph.ip_len,
 		checksumFixup32(0, pdip,
 		checksumFixup32(0, ts,
 		checksumFixup32(0, gen,
-		ip->iph.ip_sum)))))));
+		ip->iph.ip_sum))))));
+}
+
+void GGEncapper::build(click_ip *ip, uint32_t vip, uint32_t dip)
+{
+	memcpy(ip, &iphPlain, sizeof(click_ip));
+	
+	ip->ip_src.s_addr = vip;
+	ip->ip_dst.s_addr = dip;
+	
+	ip->ip_sum = checksumFold(
+		checksumFixup32(0, vip,
+		checksumFixup32(0, dip,
+		ip->ip_sum)));
+}
+
+/* hdr is a cached header: ip_len is 0 and the checksum assumes as much */
+WritablePacket *GGEncapper::prepend(Packet *p, void *hdr, int hdrLen)
+{
+	int linkLen = p->network_header() - p->data();
+	int macOffset = p->has_mac_header() ? p->mac_header() - p->data() : -1;
+	
+	/* takes headroom in place unless the packet is shared or short on headroom */
+	WritablePacket *wp = p->push(hdrLen);
+	
+	if (!wp)
+		return 0;
+	
+	/* only the link-layer header moves; the inner packet stays put */
+	if (linkLen)
+		memmove(wp->data(), wp->data() + hdrLen, linkLen);
+	if (macOffset >= 0 && macOffset < linkLen)
+		wp->set_mac_header(wp->data() + macOffset);
 	
-	wp->set_ip_header(&ip->iph, sizeof(IPHeaderWithPrevDIP));
+	click_ip *ip = reinterpret_cast<click_ip *>(wp->data() + linkLen);
+	const click_ip *inner = reinterpret_cast<const click_ip *>(wp->data() + linkLen + hdrLen);
+	size_t oldIPLen = ntohs(inner->ip_len);
+	
+	memcpyFast(reinterpret_cast<unsigned char *>(ip), reinterpret_cast<unsigned char *>(hdr), hdrLen);
+	
+	ip->ip_len = htons(oldIPLen + hdrLen);
+	ip->ip_sum = checksumFold(checksumFixup16(0, ip->ip_len, ip->ip_sum));
+	
+	wp->set_ip_header(ip, hdrLen);
 	
 	return wp;
 }
 
+WritablePacket *GGEncapper::encapsulate(Packet *p, uint32_t vip, uint32_t dip, uint32_t pdip, uint32_t ts, uint32_t gen)
+{
+	return prepend(p, cache.get(this, vip, dip, pdip, ts, gen), sizeof(IPHeaderWithPrevDIP));
+}
+
+WritablePacket *GGEncapper::encapsulateIPIP(Packet *p, uint32_t vip, uint32_t dip)
+{
+	return prepend(p, cache.getPlain(this, vip, dip), sizeof(click_ip));
+}
 }
 
 CLICK_ENDDECLS
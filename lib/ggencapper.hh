@@ -1,3 +1,6 @@
+/* outside the guard: encapper.hh includes this back once HeaderCache is in */
+#include "encapper.hh"
+
 #ifndef CLICK_BEAMER_GGENCAPPER_HH
 #define CLICK_BEAMER_GGENCAPPER_HH
 
@@ -26,14 +29,36 @@ struct IPHeaderWithPrevDIP
 	PrevDIPOption opt;
 } __attribute__((packed));
 
+/*
+ * Builds GG (and plain IPIP) outer headers, cached per CPU (see
+ * HeaderCache).
+ */
 class GGEncapper
 {
+	typedef HeaderCache<IPHeaderWithPrevDIP, click_ip> Cache;
+	friend class HeaderCache<IPHeaderWithPrevDIP, click_ip>;
+	
 	IPHeaderWithPrevDIP iphPDip;
+	click_ip iphPlain;
+	
+	Cache cache;
+	
+	void build(IPHeaderWithPrevDIP *ip, uint32_t vip, uint32_t dip, uint32_t pdip, uint32_t ts, uint32_t gen);
+	
+	void build(click_ip *ip, uint32_t vip, uint32_t dip);
+	
+	GGEncapper(const GGEncapper &);
+	GGEncapper &operator=(const GGEncapper &);
 	
 public:
 	GGEncapper();
 	
+	/* put hdr (an outer IP header and whatever follows, with ip_len == 0) in front of p's IP header */
+	static WritablePacket *prepend(Packet *p, void *hdr, int hdrLen);
+	
 	WritablePacket *encapsulate(Packet *p, uint32_t vip, uint32_t dip, uint32_t pdip, uint32_t ts, uint32_t gen);
+	
+	WritablePacket *encapsulateIPIP(Packet *p, uint32_t vip, uint32_t dip);
 };
 
 }
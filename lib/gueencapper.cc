@@ -0,0 +1,115 @@
+#include "gueencapper.hh"
+#include "ggencapper.hh"
+#include <click/glue.hh>
+#include "../../clickityclack/lib/checksumfixup.hh"
+
+CLICK_DECLS
+
+using namespace ClickityClack;
+
+namespace Beamer
+{
+
+GUEEncapper::GUEEncapper()
+{
+	setPort(GUE_DEFAULT_PORT);
+}
+
+void GUEEncapper::setPort(uint16_t port)
+{
+	memset(&hdrPDip, 0, sizeof(hdrPDip));
+	hdrPDip.iph.ip_v = 4;
+	hdrPDip.iph.ip_hl = sizeof(click_ip) >> 2;
+	hdrPDip.iph.ip_ttl = 250;
+	hdrPDip.iph.ip_p = IPPROTO_UDP;
+	hdrPDip.udph.uh_dport = htons(port);
+	hdrPDip.gue.hlen = sizeof(GUEPrevDIP) >> 2;
+	hdrPDip.gue.proto = GUE_PROTO_IPIP;
+	hdrPDip.gue.flags = htons(GUE_FLAG_PRIVATE);
+#if HAVE_FAST_CHECKSUM
+	hdrPDip.iph.ip_sum = ip_fast_csum((unsigned char *)&hdrPDip.iph, sizeof(click_ip));
+#else
+	hdrPDip.iph.ip_sum = click_in_cksum((unsigned char *)&hdrPDip.iph, sizeof(click_ip));
+#endif
+	
+	memset(&hdrPlain, 0, sizeof(hdrPlain));
+	hdrPlain.iph.ip_v = 4;
+	hdrPlain.iph.ip_hl = sizeof(click_ip) >> 2;
+	hdrPlain.iph.ip_ttl = 250;
+	hdrPlain.iph.ip_p = IPPROTO_UDP;
+	hdrPlain.udph.uh_dport = htons(port);
+	hdrPlain.gue.proto = GUE_PROTO_IPIP;
+#if HAVE_FAST_CHECKSUM
+	hdrPlain.iph.ip_sum = ip_fast_csum((unsigned char *)&hdrPlain.iph, sizeof(click_ip));
+#else
+	hdrPlain.iph.ip_sum = click_in_cksum((unsigned char *)&hdrPlain.iph, sizeof(click_ip));
+#endif
+	
+	/* cached headers have the old port in them */
+	cache.reset(this);
+}
+
+void GUEEncapper::build(GUEOuterHeaderWithPrevDIP *hdr, uint32_t vip, uint32_t dip, uint32_t pdip, uint32_t ts, uint32_t gen)
+{
+	memcpy(hdr, &hdrPDip, sizeof(GUEOuterHeaderWithPrevDIP));
+	
+	hdr->iph.ip_src.s_addr = vip;
+	hdr->iph.ip_dst.s_addr = dip;
+	hdr->priv.pdip = pdip;
+	hdr->priv.ts = ts;
+	hdr->priv.gen = gen;
+	
+	/* the metadata is past the IP header this time */
+	hdr->iph.ip_sum = checksumFold(
+		checksumFixup32(0, vip,
+		checksumFixup32(0, dip,
+		hdr->iph.ip_sum)));
+}
+
+void GUEEncapper::build(GUEOuterHeader *hdr, uint32_t vip, uint32_t dip)
+{
+	memcpy(hdr, &hdrPlain, sizeof(GUEOuterHeader));
+	
+	hdr->iph.ip_src.s_addr = vip;
+	hdr->iph.ip_dst.s_addr = dip;
+	
+	hdr->iph.ip_sum = checksumFold(
+		checksumFixup32(0, vip,
+		checksumFixup32(0, dip,
+		hdr->iph.ip_sum)));
+}
+
+/* the UDP checksum stays 0, so the ports and length don't touch any checksum */
+WritablePacket *GUEEncapper::prepend(Packet *p, void *hdr, int hdrLen, uint32_t hash)
+{
+	WritablePacket *wp = GGEncapper::prepend(p, hdr, hdrLen);
+	
+	if (!wp)
+		return 0;
+	
+	click_ip *ip = wp->ip_header();
+	click_udp *udp = reinterpret_cast<click_udp *>(ip + 1);
+	
+	udp->uh_sport = sourcePort(hash);
+	udp->uh_ulen = htons(ntohs(ip->ip_len) - sizeof(click_ip));
+	
+	wp->set_ip_header(ip, sizeof(click_ip));
+	
+	return wp;
+}
+
+WritablePacket *GUEEncapper::encapsulate(Packet *p, uint32_t vip, uint32_t dip, uint32_t pdip, uint32_t ts, uint32_t gen, uint32_t hash)
+{
+	return prepend(p, cache.get(this, vip, dip, pdip, ts, gen), sizeof(GUEOuterHeaderWithPrevDIP), hash);
+}
+
+WritablePacket *GUEEncapper::encapsulatePlain(Packet *p, uint32_t vip, uint32_t dip, uint32_t hash)
+{
+	return prepend(p, cache.getPlain(this, vip, dip), sizeof(GUEOuterHeader), hash);
+}
+}
+
+CLICK_ENDDECLS
+
+ELEMENT_REQUIRES(Beamer_GGEncapper)
+ELEMENT_PROVIDES(Beamer_GUEEncapper)
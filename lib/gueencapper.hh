@@ -0,0 +1,114 @@
+/* outside the guard: encapper.hh includes this back once HeaderCache is in */
+#include "encapper.hh"
+
+#ifndef CLICK_BEAMER_GUEENCAPPER_HH
+#define CLICK_BEAMER_GUEENCAPPER_HH
+
+#include <click/config.h>
+#include <clicknet/ip.h>
+#include <clicknet/udp.h>
+#include <click/packet.hh>
+#include <click/glue.hh>
+
+CLICK_DECLS
+
+namespace Beamer
+{
+
+const uint16_t GUE_DEFAULT_PORT = 6080;
+
+/* GUE protocol numbers follow IP's */
+const uint8_t GUE_PROTO_IPIP = IPPROTO_IPIP;
+
+/* private data present: the PrevDIP metadata, see GUEPrevDIP */
+const uint16_t GUE_FLAG_PRIVATE = 0x0001;
+
+struct GUEHeader
+{
+#if CLICK_BYTE_ORDER == CLICK_LITTLE_ENDIAN
+	uint8_t hlen:5, /* in 32-bit words, past this header */
+		control:1,
+		ver:2;
+#elif CLICK_BYTE_ORDER == CLICK_BIG_ENDIAN
+	uint8_t ver:2,
+		control:1,
+		hlen:5;
+#else
+#error Unknown byte order
+#endif
+	uint8_t proto;
+	uint16_t flags;
+} __attribute__((packed));
+
+/* the same metadata PrevDIPOption carries */
+struct GUEPrevDIP
+{
+	uint32_t pdip;
+	uint32_t ts;
+	uint32_t gen;
+} __attribute__((packed));
+
+struct GUEOuterHeader
+{
+	click_ip iph;
+	click_udp udph;
+	GUEHeader gue;
+} __attribute__((packed));
+
+struct GUEOuterHeaderWithPrevDIP
+{
+	click_ip iph;
+	click_udp udph;
+	GUEHeader gue;
+	GUEPrevDIP priv;
+} __attribute__((packed));
+
+/*
+ * Builds GUE outer headers: IPv4, UDP without a checksum, and a GUE header
+ * carrying the PrevDIP metadata as private data if there is any. Like
+ * GGEncapper's, headers are cached per CPU (see HeaderCache); what varies
+ * per packet (lengths, and the source port, which gives ECMP its entropy)
+ * costs the same whatever the header holds.
+ */
+class GUEEncapper
+{
+	typedef HeaderCache<GUEOuterHeaderWithPrevDIP, GUEOuterHeader> Cache;
+	friend class HeaderCache<GUEOuterHeaderWithPrevDIP, GUEOuterHeader>;
+	
+	GUEOuterHeaderWithPrevDIP hdrPDip;
+	GUEOuterHeader hdrPlain;
+	
+	Cache cache;
+	
+	/* within the ephemeral range, so that nothing mistakes it for a service */
+	static inline uint16_t sourcePort(uint32_t hash)
+	{
+		return htons(0xc000 | ((hash ^ (hash >> 16)) & 0x3fff));
+	}
+	
+	void build(GUEOuterHeaderWithPrevDIP *hdr, uint32_t vip, uint32_t dip, uint32_t pdip, uint32_t ts, uint32_t gen);
+	
+	void build(GUEOuterHeader *hdr, uint32_t vip, uint32_t dip);
+	
+	WritablePacket *prepend(Packet *p, void *hdr, int hdrLen, uint32_t hash);
+	
+	GUEEncapper(const GUEEncapper &);
+	GUEEncapper &operator=(const GUEEncapper &);
+	
+public:
+	GUEEncapper();
+	
+	/* before any packets go through */
+	void setPort(uint16_t port);
+	
+	/* hash is the flow's, for the source port */
+	WritablePacket *encapsulate(Packet *p, uint32_t vip, uint32_t dip, uint32_t pdip, uint32_t ts, uint32_t gen, uint32_t hash);
+	
+	WritablePacket *encapsulatePlain(Packet *p, uint32_t vip, uint32_t dip, uint32_t hash);
+};
+
+}
+
+CLICK_ENDDECLS
+
+#endif /* CLICK_BEAMER_GUEENCAPPER_HH */
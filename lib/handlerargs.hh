@@ -0,0 +1,64 @@
+#ifndef CLICK_BEAMER_HANDLERARGS_HH
+#define CLICK_BEAMER_HANDLERARGS_HH
+
+#include <click/config.h>
+#include <click/string.hh>
+#include <click/vector.hh>
+#include <click/ipaddress.hh>
+#include <click/args.hh>
+#include <click/error.hh>
+
+CLICK_DECLS
+
+namespace Beamer
+{
+
+/* splits a write handler's argument on spaces */
+static inline void tokenize(const String &str, int startIndex, Vector<String> *vec)
+{
+	if (startIndex == str.length())
+		return;
+	
+	int spaceIndex = str.find_left(' ', startIndex);
+	
+	if (spaceIndex == -1) /* no spaces */
+	{
+		vec->push_back(str.substring(startIndex, str.length() - startIndex));
+	}
+	else if (spaceIndex == startIndex) /* starts with space */
+	{
+		tokenize(str, startIndex + 1, vec);
+	}
+	else /* got some space */
+	{
+		vec->push_back(str.substring(startIndex, spaceIndex - startIndex));
+		tokenize(str, spaceIndex + 1, vec);
+	}
+}
+
+/* "DIP BUCKET..." from tokens[first] on, as the assign handlers take it; buckets must be below ringSize */
+static inline int parseAssignment(const Vector<String> &tokens, int first, unsigned long ringSize, IPAddress *dip, Vector<unsigned long> *buckets, ErrorHandler *errh)
+{
+	if (tokens.size() < first + 2)
+		return errh->error("expected %d+ arguments, got %d", first + 2, tokens.size());
+	
+	if (!IPAddressArg().parse(tokens[first], *dip))
+		return errh->error("bad DIP");
+	
+	for (int i = first + 1; i < tokens.size(); i++)
+	{
+		int index;
+		
+		if (!IntArg().parse(tokens[i], index) || index < 0 || (unsigned long)index >= ringSize)
+			return errh->error("bad index %s", tokens[i].c_str());
+		buckets->push_back(index);
+	}
+	
+	return 0;
+}
+
+}
+
+CLICK_ENDDECLS
+
+#endif /* CLICK_BEAMER_HANDLERARGS_HH */
@@ -0,0 +1,109 @@
+#ifndef CLICK_BEAMER_MUXPOLICY_HH
+#define CLICK_BEAMER_MUXPOLICY_HH
+
+#include <click/config.h>
+#include <click/error.hh>
+#include <click/vector.hh>
+#include "beamerhash.hh"
+#include "dipmap.hh"
+#include "encapper.hh"
+
+CLICK_DECLS
+
+namespace Beamer
+{
+
+/* what a mux was configured with */
+struct MuxPolicies
+{
+	HashKind hash;
+	ReductionKind reduction;
+	EncapKind encap;
+	
+	MuxPolicies()
+		: hash(HASH_CRC), reduction(REDUCE_MODULO), encap(ENCAP_GG) {}
+};
+
+/*
+ * What RSS_CPU and RSS_RETA_SIZE make for RingTable::setSlicing(): the
+ * number of slice bits, 0 if there's no RSS to line up with. cpus has the
+ * CPU serving each queue, in queue order. Lining up needs the ring's low
+ * bits to be the RSS hash's. Returns -1 on error, like configure().
+ */
+static inline int rssSliceBits(const MuxPolicies &policies, const Vector<int> &cpus, int retaSize, ErrorHandler *errh)
+{
+	int bits = 0;
+	
+	if (!cpus.size())
+		return 0;
+	
+	if (policies.hash != HASH_TOEPLITZ || policies.reduction != REDUCE_MASK)
+		return errh->error("RSS_CPU needs HASH TOEPLITZ and REDUCE MASK");
+	if (retaSize < 2 || retaSize > (1 << TOEPLITZ_RSS_RETA_BITS) || (retaSize & (retaSize - 1)))
+		return errh->error("Bad RSS_RETA_SIZE: expected a power of 2 up to %d", 1 << TOEPLITZ_RSS_RETA_BITS);
+	if (cpus.size() > retaSize)
+		return errh->error("More RSS_CPUs than RSS_RETA_SIZE entries");
+	for (int i = 0; i < cpus.size(); i++)
+	{
+		if (cpus[i] < 0 || cpus[i] >= click_max_cpu_ids())
+			return errh->error("Bad RSS_CPU %d", cpus[i]);
+	}
+	
+	while ((1 << bits) < retaSize)
+		bits++;
+	return bits;
+}
+
+/*
+ * Turns MuxPolicies into PICKER::pick<HASH, REDUCTION, ENCAP>(), normally
+ * a pointer to a mux's stage function compiled for just that combination.
+ * Muxes pick once, at configure time; past that, packets never branch on
+ * a policy.
+ */
+template <typename PICKER, typename HASH, typename REDUCTION>
+static typename PICKER::Result pickEncap(const MuxPolicies &policies)
+{
+	switch (policies.encap)
+	{
+	case ENCAP_IPIP:
+		return PICKER::template pick<HASH, REDUCTION, IPIPEncap>();
+	case ENCAP_GUE:
+		return PICKER::template pick<HASH, REDUCTION, GUEEncap>();
+	default:
+		return PICKER::template pick<HASH, REDUCTION, GGEncap>();
+	}
+}
+
+template <typename PICKER, typename HASH>
+static typename PICKER::Result pickReduction(const MuxPolicies &policies)
+{
+	switch (policies.reduction)
+	{
+	case REDUCE_MASK:
+		return pickEncap<PICKER, HASH, MaskReduction>(policies);
+	case REDUCE_MULTIPLY_SHIFT:
+		return pickEncap<PICKER, HASH, MultiplyShiftReduction>(policies);
+	default:
+		return pickEncap<PICKER, HASH, ModuloReduction>(policies);
+	}
+}
+
+template <typename PICKER>
+static typename PICKER::Result pickPolicies(const MuxPolicies &policies)
+{
+	switch (policies.hash)
+	{
+	case HASH_BOB:
+		return pickReduction<PICKER, BOBHash>(policies);
+	case HASH_TOEPLITZ:
+		return pickReduction<PICKER, ToeplitzHash>(policies);
+	default:
+		return pickReduction<PICKER, CRCHash>(policies);
+	}
+}
+
+}
+
+CLICK_ENDDECLS
+
+#endif /* CLICK_BEAMER_MUXPOLICY_HH */
@@ -18,6 +18,9 @@ uint32_t p4_crc32(const char *buf, size_t len);
 
 uint32_t p4_crc32_6(const char *buf);
 
+/* hashes count touples at once; output is bit-identical to p4_crc32_6() */
+void p4_crc32_6_batch(const HashTouple *touples, uint32_t *hashes, int count);
+
 }
 
 CLICK_ENDDECLS
@@ -0,0 +1,84 @@
+#ifndef CLICK_BEAMER_QUIESCENTSTATES_HH
+#define CLICK_BEAMER_QUIESCENTSTATES_HH
+
+#include <click/config.h>
+#include <click/glue.hh>
+#include <click/vector.hh>
+
+CLICK_DECLS
+
+namespace Beamer
+{
+
+/*
+ * Tells writers when readers are done with a buffer they replaced. Each
+ * CPU has a counter that is odd while it's in a batch and even in between.
+ * Batches don't hold on to views, so once every CPU that was in a batch
+ * when a buffer got replaced has left it, nobody can see that buffer
+ * anymore. Idle CPUs sit at even counts and hold nobody up.
+ */
+class QuiescentStates
+{
+	struct CPUState
+	{
+		uint32_t seq;
+	} __attribute__((aligned(64)));
+	
+	CPUState *states;
+	int cpuCount;
+	
+	QuiescentStates(const QuiescentStates &);
+	QuiescentStates &operator=(const QuiescentStates &);
+	
+public:
+	typedef Vector<uint32_t> Snapshot;
+	
+	QuiescentStates()
+		: cpuCount(click_max_cpu_ids())
+	{
+		states = new CPUState[cpuCount](); assert(states);
+	}
+	
+	~QuiescentStates()
+	{
+		delete[] states;
+	}
+	
+	/* before the batch's first view(); a full barrier, so no view is loaded ahead of it */
+	void enter(unsigned int cpuID)
+	{
+		__atomic_store_n(&states[cpuID].seq, states[cpuID].seq + 1, __ATOMIC_SEQ_CST);
+	}
+	
+	/* once the batch is done with its views */
+	void exit(unsigned int cpuID)
+	{
+		__atomic_store_n(&states[cpuID].seq, states[cpuID].seq + 1, __ATOMIC_RELEASE);
+	}
+	
+	/* right after replacing a buffer */
+	void snapshot(Snapshot *snap) const
+	{
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		snap->resize(cpuCount);
+		for (int i = 0; i < cpuCount; i++)
+			(*snap)[i] = __atomic_load_n(&states[i].seq, __ATOMIC_ACQUIRE);
+	}
+	
+	/* whether every CPU that was in a batch at snap has left it since; never waits */
+	bool passed(const Snapshot &snap) const
+	{
+		for (int i = 0; i < cpuCount; i++)
+		{
+			if ((snap[i] & 1) && __atomic_load_n(&states[i].seq, __ATOMIC_ACQUIRE) == snap[i])
+				return false;
+		}
+		return true;
+	}
+};
+
+}
+
+CLICK_ENDDECLS
+
+#endif /* CLICK_BEAMER_QUIESCENTSTATES_HH */
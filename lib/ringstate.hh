@@ -0,0 +1,160 @@
+#ifndef CLICK_BEAMER_RINGSTATE_HH
+#define CLICK_BEAMER_RINGSTATE_HH
+
+#include <click/config.h>
+#include <click/string.hh>
+#include <click/vector.hh>
+#include <click/ipaddress.hh>
+#include <click/error.hh>
+#include "dipmap.hh"
+#include "zkclient.hh"
+#include "dumper.hh"
+
+CLICK_DECLS
+
+namespace Beamer
+{
+
+/*
+ * Everything a mux gets from ZooKeeper for one VIP: the VIP itself, the
+ * ring and the id map, along with the clients keeping them up to date.
+ * Each VIP has its own subtree (prefix); the default one is the original
+ * single-service layout.
+ */
+struct RingState
+{
+	IPAddress vip;
+	
+	RingMap bucketMap;
+	ZKClient<RingMap> hashZkClient;
+	
+	PlainDIPMap idMap;
+	ZKClient<PlainDIPMap> idZkClient;
+	
+	String prefix;
+	
+	int fetchWindow;
+	int replayThreads;
+	
+	/* see RingMap::slice(); 0 = no slices */
+	int sliceBits;
+	Vector<int> sliceNodes;
+	
+	RingState(const String &prefix = "/beamer/")
+		: hashZkClient(prefix + "mux_ring/", &bucketMap), idZkClient(prefix + "id/", &idMap), prefix(prefix), fetchWindow(0), replayThreads(1), sliceBits(0) {}
+	
+	/* follow the subtree over an already established session; returns -errno */
+	int setUp(zhandle_t *zooHandle)
+	{
+		int32_t vipAddr;
+		int32_t ringSize;
+		int err;
+		
+		hashZkClient.attach(zooHandle);
+		idZkClient.attach(zooHandle);
+		
+		/* the prefix comes from SERVICE: there may well be nothing there */
+		if ((err = hashZkClient.readInt32(prefix + "config/vip", &vipAddr)) < 0)
+			return err;
+		if ((err = hashZkClient.readInt32(prefix + "config/ring_size", &ringSize)) < 0)
+			return err;
+		if (ringSize <= 0)
+			return -EINVAL;
+		
+		vip = IPAddress(vipAddr);
+		bucketMap.init(ringSize);
+		if (sliceBits)
+			bucketMap.slice(sliceBits, sliceNodes);
+		idMap.init(0x10000);
+		return 0;
+	}
+	
+	/* no ZooKeeper: start from a blank ring of ringSize */
+	void setUp(IPAddress vip, int ringSize)
+	{
+		this->vip = vip;
+		bucketMap.init(ringSize);
+		if (sliceBits)
+			bucketMap.slice(sliceBits, sliceNodes);
+		idMap.init(0x10000);
+	}
+	
+	/* before setUp(); readers enter and exit these around their batches */
+	void setReaders(const QuiescentStates *readers)
+	{
+		bucketMap.setReaders(readers);
+		idMap.setReaders(readers);
+	}
+	
+	/* before setUp(); a ring that can't be sliced that way is left whole */
+	void setSlicing(int bits, const Vector<int> &nodes)
+	{
+		sliceBits = bits;
+		sliceNodes = nodes;
+	}
+	
+	/* forward from local snapshots right away; ZooKeeper catches up from their gens */
+	void loadSnapshots(const String &snapshot, const String &idSnapshot, ErrorHandler *errh)
+	{
+		if (snapshot.length() != 0)
+		{
+			int err = Dumper::load(&hashZkClient, snapshot);
+			if (err < 0)
+				errh->warning("Ignoring snapshot %s: %s", snapshot.c_str(), strerror(-err));
+		}
+		if (idSnapshot.length() != 0)
+		{
+			int err = Dumper::load(&idZkClient, idSnapshot);
+			if (err < 0)
+				errh->warning("Ignoring snapshot %s: %s", idSnapshot.c_str(), strerror(-err));
+		}
+	}
+	
+	/*
+	 * What the assign handlers do; buckets are below bucketMap.size().
+	 * Goes in under the client's update lock, like ZooKeeper updates, so a
+	 * dump never sees half an assignment and a blob install can't swap the
+	 * map out from under it. Returns -errno.
+	 */
+	int assign(uint32_t dip, const Vector<unsigned long> &buckets)
+	{
+		DIPHistoryLogHeader ts;
+		int err = 0;
+		
+		ts.timestamp = time(NULL);
+		hashZkClient.lockUpdates();
+		for (int i = 0; i < buckets.size() && err == 0; i++)
+			err = bucketMap.updateEntry(buckets[i], dip, ts);
+		hashZkClient.unlockUpdates();
+		return err;
+	}
+	
+	void setFetchWindow(int window)
+	{
+		fetchWindow = window;
+		hashZkClient.setFetchWindow(window);
+		idZkClient.setFetchWindow(window);
+	}
+	
+	void setReplayThreads(int threads)
+	{
+		replayThreads = threads;
+		hashZkClient.setReplayThreads(threads);
+		idZkClient.setReplayThreads(threads);
+	}
+	
+	void sync()
+	{
+		if (hashZkClient.isLive())
+			hashZkClient.sync();
+		
+		if (idZkClient.isLive())
+			idZkClient.sync();
+	}
+};
+
+}
+
+CLICK_ENDDECLS
+
+#endif /* CLICK_BEAMER_RINGSTATE_HH */
@@ -0,0 +1,345 @@
+#ifndef CLICK_BEAMER_RINGTABLE_HH
+#define CLICK_BEAMER_RINGTABLE_HH
+
+#include <click/config.h>
+#include <click/string.hh>
+#include <click/vector.hh>
+#include <click/ipaddress.hh>
+#include <click/error.hh>
+#include <zookeeper/zookeeper.h>
+#if HAVE_NUMA
+#include <numa.h>
+#endif
+#include "ringstate.hh"
+
+CLICK_DECLS
+
+namespace Beamer
+{
+
+/*
+ * The rings a mux serves, one per VIP, all kept up to date over a single
+ * ZooKeeper session. VIPs are found through a small open addressing index
+ * that stays in a couple of cache lines for the few dozen VIPs a mux
+ * would carry. Muxes keep the table on the heap so that a hotswapped
+ * instance can take it over as is, sessions and all, rather than download
+ * every ring again.
+ */
+class RingTable
+{
+	zhandle_t *zooHandle;
+	
+	Vector<RingState *> rings;
+	
+	/* ring index + 1 by VIP; 0 = empty */
+	Vector<uint32_t> slotVIPs;
+	Vector<uint8_t> slotRings;
+	uint32_t slotMask;
+	
+	/* what it was set up from */
+	String spec;
+	
+	int fetchWindow;
+	int replayThreads;
+	
+	/* slicing for every ring; see setSlicing() */
+	int sliceBits;
+	Vector<int> sliceNodes;
+	
+	/* the muxes' batches, for every ring's maps */
+	QuiescentStates quiescentStates;
+	
+	static void sessionWatcher(zhandle_t *zh, int type, int state, const char *path, void *watcherCtx)
+	{
+		/* node watches go to the clients; nothing to do about the session itself */
+		(void)zh; (void)type; (void)state; (void)path; (void)watcherCtx;
+	}
+	
+	static inline uint32_t slot(uint32_t vip)
+	{
+		return (vip * 0x9e3779b1) >> 16;
+	}
+	
+	/* at most half full */
+	void reindex()
+	{
+		uint32_t count = 4;
+		
+		while (count < 2 * (uint32_t)rings.size())
+			count <<= 1;
+		slotMask = count - 1;
+		
+		slotVIPs.clear();
+		slotVIPs.resize(count, 0);
+		slotRings.clear();
+		slotRings.resize(count, 0);
+		for (int i = 0; i < rings.size(); i++)
+		{
+			uint32_t s = slot(rings[i]->vip.addr());
+			
+			while (slotRings[s & slotMask])
+				s++;
+			slotVIPs[s & slotMask] = rings[i]->vip.addr();
+			slotRings[s & slotMask] = i + 1;
+		}
+	}
+	
+	int add(RingState *ring)
+	{
+		if (find(ring->vip.addr()) >= 0)
+		{
+			delete ring;
+			return -EEXIST;
+		}
+		
+		rings.push_back(ring);
+		reindex();
+		return 0;
+	}
+	
+	RingTable(const RingTable &);
+	RingTable &operator=(const RingTable &);
+	
+public:
+	/* ring indices fit in a uint8_t */
+	static const int MAX_RINGS = 255;
+	
+	RingTable(const String &spec)
+		: zooHandle(NULL), slotMask(0), spec(spec), fetchWindow(16), replayThreads(1), sliceBits(0) {}
+	
+	~RingTable()
+	{
+		/* closing calls back every pending request; the clients have to be done first */
+		for (int i = 0; i < rings.size(); i++)
+		{
+			rings[i]->hashZkClient.stop();
+			rings[i]->idZkClient.stop();
+		}
+		
+		/* no more callbacks into the clients past this point */
+		if (zooHandle)
+			zookeeper_close(zooHandle);
+		
+		for (int i = 0; i < rings.size(); i++)
+			delete rings[i];
+	}
+	
+	/* what a configuration asks for, in a form that compares */
+	static String describe(const String &zkConnectString, const Vector<String> &services, const Vector<IPAddress> &vips, int ringSize)
+	{
+		String spec = zkConnectString;
+		
+		for (int i = 0; i < services.size(); i++)
+			spec += " " + services[i];
+		for (int i = 0; i < vips.size(); i++)
+			spec += " " + vips[i].unparse();
+		
+		/* rings from ZooKeeper come with their own size */
+		if (zkConnectString.length() == 0)
+			spec += " " + String(ringSize);
+		return spec;
+	}
+	
+	/* tables set up from the same spec can stand in for each other */
+	const String &getSpec() const
+	{
+		return spec;
+	}
+	
+	/*
+	 * One ring per SERVICE subtree with ZooKeeper (just the default one if
+	 * there are none), one per VIP without. Reports to errh; returns -1 on
+	 * failure, like configure().
+	 */
+	int setUp(const String &zkConnectString, const Vector<String> &services, const Vector<IPAddress> &vips, int ringSize, ErrorHandler *errh)
+	{
+		int err;
+		
+		if (zkConnectString.length() == 0)
+		{
+			if (services.size())
+				return errh->error("SERVICE needs ZK");
+			
+			/* a single local ring doesn't care where packets are headed */
+			if (!vips.size())
+				return addLocal(0, ringSize);
+			
+			for (int i = 0; i < vips.size(); i++)
+			{
+				if ((err = addLocal(vips[i], ringSize)) < 0)
+					return errh->error("Bad VIP %s: %s", vips[i].unparse().c_str(), strerror(-err));
+			}
+			return 0;
+		}
+		
+		if (vips.size())
+			return errh->error("VIP is for rings without ZK; use SERVICE");
+		
+		if ((err = connect(zkConnectString)) < 0)
+			return errh->error("Error connectiong to ZooKeeper: %s", strerror(-err));
+		
+		if (!services.size())
+		{
+			if ((err = addService("/beamer/")) < 0)
+				return errh->error("Bad ring under /beamer/: %s", strerror(-err));
+			return 0;
+		}
+		
+		for (int i = 0; i < services.size(); i++)
+		{
+			String prefix = services[i];
+			
+			if (!prefix.length() || prefix[prefix.length() - 1] != '/')
+				prefix += "/";
+			if ((err = addService(prefix)) < 0)
+				return errh->error("Bad SERVICE %s: %s", services[i].c_str(), strerror(-err));
+		}
+		return 0;
+	}
+	
+	/* returns -errno */
+	int connect(const String &zkConnectString)
+	{
+		zooHandle = zookeeper_init(zkConnectString.c_str(), sessionWatcher, 10000, NULL, this, 0);
+		if (!zooHandle)
+			return -errno;
+		
+		return 0;
+	}
+	
+	bool isLive() const
+	{
+		return zooHandle != NULL;
+	}
+	
+	/* a VIP in ZooKeeper under prefix; needs connect() first. Returns -errno */
+	int addService(const String &prefix)
+	{
+		if (rings.size() >= MAX_RINGS)
+			return -ENOSPC;
+		
+		RingState *ring = new RingState(prefix); assert(ring);
+		int err;
+		
+		ring->setFetchWindow(fetchWindow);
+		ring->setReplayThreads(replayThreads);
+		ring->setSlicing(sliceBits, sliceNodes);
+		ring->setReaders(&quiescentStates);
+		if ((err = ring->setUp(zooHandle)) < 0)
+		{
+			delete ring;
+			return err;
+		}
+		return add(ring);
+	}
+	
+	/* a VIP with a ring of its own, fed through handlers only */
+	int addLocal(IPAddress vip, int ringSize)
+	{
+		if (rings.size() >= MAX_RINGS)
+			return -ENOSPC;
+		
+		RingState *ring = new RingState(); assert(ring);
+		
+		ring->setSlicing(sliceBits, sliceNodes);
+		ring->setReaders(&quiescentStates);
+		ring->setUp(vip, ringSize);
+		return add(ring);
+	}
+	
+	int size() const
+	{
+		return rings.size();
+	}
+	
+	RingState *get(int index) const
+	{
+		return rings[index];
+	}
+	
+	/* muxes enter() before a batch looks at any ring and exit() after */
+	QuiescentStates *readers()
+	{
+		return &quiescentStates;
+	}
+	
+	/* the ring serving vip, or -1 */
+	int find(uint32_t vip) const
+	{
+		if (!rings.size())
+			return -1;
+		
+		for (uint32_t s = slot(vip); ; s++)
+		{
+			uint8_t ring = slotRings[s & slotMask];
+			
+			if (!ring)
+				return -1;
+			if (slotVIPs[s & slotMask] == vip)
+				return ring - 1;
+		}
+	}
+	
+	/*
+	 * Slice rings by the low bits buckets share with the RSS hash (see
+	 * toeplitz_6()), one slice per entry of a 2^bits indirection table that
+	 * spreads over queues evenly. Slices go on the NUMA node of the CPU
+	 * serving their queue; cpus has one per queue, in queue order. Before
+	 * setUp(); it's part of the spec, as tables sliced differently can't
+	 * stand in for each other.
+	 */
+	void setSlicing(int bits, const Vector<int> &cpus)
+	{
+		sliceBits = bits;
+		sliceNodes.clear();
+		for (int i = 0; i < (1 << bits); i++)
+		{
+			int node = 0;
+			
+#if HAVE_NUMA
+			if (numa_available() >= 0)
+				node = numa_node_of_cpu(cpus[i % cpus.size()]);
+#endif
+			sliceNodes.push_back(node >= 0 ? node : 0);
+		}
+		
+		spec += " slices " + String(1 << bits) + " on";
+		for (int i = 0; i < cpus.size(); i++)
+			spec += (i ? "," : " ") + String(cpus[i]);
+	}
+	
+	/* set before adding services */
+	void setFetchWindow(int window)
+	{
+		fetchWindow = window;
+	}
+	
+	void setReplayThreads(int threads)
+	{
+		replayThreads = threads;
+	}
+	
+	/* take on the tunables of another (not yet set up) instance */
+	void retune(const RingTable *other)
+	{
+		fetchWindow = other->fetchWindow;
+		replayThreads = other->replayThreads;
+		for (int i = 0; i < rings.size(); i++)
+		{
+			rings[i]->setFetchWindow(fetchWindow);
+			rings[i]->setReplayThreads(replayThreads);
+		}
+	}
+	
+	void sync()
+	{
+		for (int i = 0; i < rings.size(); i++)
+			rings[i]->sync();
+	}
+};
+
+}
+
+CLICK_ENDDECLS
+
+#endif /* CLICK_BEAMER_RINGTABLE_HH */
@@ -0,0 +1,123 @@
+#ifndef CLICK_BEAMER_TIMERWHEEL_HH
+#define CLICK_BEAMER_TIMERWHEEL_HH
+
+#include <click/config.h>
+#include <click/vector.hh>
+
+CLICK_DECLS
+
+namespace Beamer
+{
+
+/*
+ * Two-level hashed timer wheel, good for deadlines up to 0x7fff ticks
+ * out. Timers can't be cancelled; owners are expected to check
+ * whether what fires is still relevant (and reschedule if need be), which
+ * keeps refreshes free.
+ */
+class TimerWheel
+{
+public:
+	struct Timer
+	{
+		uint32_t id;
+		uint32_t tick;
+	};
+	
+private:
+	static const int L0_SLOTS = 256;
+	static const int L1_SLOTS = 128; /* of L0_SLOTS ticks each */
+	
+	Vector<Timer> level0[L0_SLOTS];
+	Vector<Timer> level1[L1_SLOTS];
+	
+	/* the tick whose slot is drained next */
+	uint32_t current;
+	
+	int pending;
+	
+	/* move the timers of the L0_SLOTS ticks that just came up into level 0 */
+	void cascade()
+	{
+		Vector<Timer> &slot = level1[(current / L0_SLOTS) % L1_SLOTS];
+		
+		for (int i = 0; i < slot.size(); i++)
+			level0[slot[i].tick % L0_SLOTS].push_back(slot[i]);
+		slot.clear();
+	}
+	
+public:
+	TimerWheel(uint32_t now = 0)
+		: current(now), pending(0) {}
+	
+	void schedule(uint32_t id, uint32_t tick)
+	{
+		Timer timer = { id, tick };
+		int32_t delta = tick - current;
+		
+		/* already due: fire with the current slot */
+		if (delta < 0)
+			delta = 0;
+		
+		if (delta + (current % L0_SLOTS) < L0_SLOTS)
+			level0[(current + delta) % L0_SLOTS].push_back(timer);
+		else
+			level1[(tick / L0_SLOTS) % L1_SLOTS].push_back(timer);
+		pending++;
+	}
+	
+	/* how many ticks the wheel trails now by; 0 if nothing is pending */
+	uint32_t behind(uint32_t now) const
+	{
+		return pending && (int32_t)(now - current) > 0 ? now - current : 0;
+	}
+	
+	/* pops at most max timers due by now into due; returns how many */
+	int advance(uint32_t now, Timer *due, int max)
+	{
+		int count = 0;
+		
+		/* nothing to walk through; also covers long idle periods */
+		if (!pending)
+		{
+			current = now - now % L0_SLOTS;
+			return 0;
+		}
+		
+		/* the clock went backwards (jiffies wrapped); pending timers fire off schedule */
+		if ((int32_t)(now - current) < -1)
+			current = now - now % L0_SLOTS;
+		
+		while ((int32_t)(current - now) <= 0)
+		{
+			Vector<Timer> &slot = level0[current % L0_SLOTS];
+			
+			while (slot.size() && count < max)
+			{
+				due[count++] = slot.back();
+				slot.pop_back();
+				pending--;
+			}
+			if (slot.size())
+				break;
+			
+			if (!pending)
+			{
+				current = now - now % L0_SLOTS;
+				break;
+			}
+			
+			current++;
+			if (current % L0_SLOTS == 0)
+				cascade();
+		}
+		
+		return count;
+	}
+};
+
+}
+
+CLICK_ENDDECLS
+
+#endif /* CLICK_BEAMER_TIMERWHEEL_HH */
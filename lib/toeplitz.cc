@@ -0,0 +1,482 @@
+#include "toeplitz.hh"
+
+CLICK_DECLS
+
+namespace Beamer
+{
+
+const uint8_t TOEPLITZ_DEFAULT_KEY[TOEPLITZ_KEY_LEN] = {
+	0x6d, 0x5a, 0x56, 0xda, 0x25, 0x5b, 0x0e, 0xc2,
+	0x41, 0x67, 0x25, 0x3d, 0x43, 0xa3, 0x8f, 0xb0,
+	0xd0, 0xca, 0x2b, 0xcb, 0xae, 0x7b, 0x30, 0xb4,
+	0x77, 0xcb, 0x2d, 0xa3, 0x80, 0x30, 0xf2, 0x0c,
+	0x6a, 0x42, 0xb7, 0x3b, 0xbe, 0xac, 0x01, 0xfa,
+};
+
+/*
+ * TOEPLITZ_DEFAULT_KEY with the bits cleared that the destination address
+ * and port would hash through into the low TOEPLITZ_RSS_RETA_BITS bits
+ */
+const uint8_t TOEPLITZ_RSS_KEY[TOEPLITZ_KEY_LEN] = {
+	0x6d, 0x5a, 0x56, 0xda, 0x25, 0x5b, 0x0e, 0x00,
+	0x00, 0x00, 0x00, 0x01, 0x42, 0x00, 0x00, 0x00,
+	0xd0, 0xca, 0x2b, 0xcb, 0xae, 0x7b, 0x30, 0xb4,
+	0x77, 0xcb, 0x2d, 0xa3, 0x80, 0x30, 0xf2, 0x0c,
+	0x6a, 0x42, 0xb7, 0x3b, 0xbe, 0xac, 0x01, 0xfa,
+};
+
+/* contribution of each touple byte to toeplitz_6(), at its place in the RSS input */
+static const uint32_t table_toeplitz_6[6][256] = {
+	{
+		0x00000000, 0xAD2B6D12, 0x5695B689, 0xFBBEDB9B,
+		0xAB4ADB44, 0x0661B656, 0xFDDF6DCD, 0x50F400DF,
+		0xD5A56DA2, 0x788E00B0, 0x8330DB2B, 0x2E1BB639,
+		0x7EEFB6E6, 0xD3C4DBF4, 0x287A006F, 0x85516D7D,
+		0x6AD2B6D1, 0xC7F9DBC3, 0x3C470058, 0x916C6D4A,
+		0xC1986D95, 0x6CB30087, 0x970DDB1C, 0x3A26B60E,
+		0xBF77DB73, 0x125CB661, 0xE9E26DFA, 0x44C900E8,
+		0x143D0037, 0xB9166D25, 0x42A8B6BE, 0xEF83DBAC,
+		0xB5695B68, 0x1842367A, 0xE3FCEDE1, 0x4ED780F3,
+		0x1E23802C, 0xB308ED3E, 0x48B636A5, 0xE59D5BB7,
+		0x60CC36CA, 0xCDE75BD8, 0x36598043, 0x9B72ED51,
+		0xCB86ED8E, 0x66AD809C, 0x9D135B07, 0x30383615,
+		0xDFBBEDB9, 0x729080AB, 0x892E5B30, 0x24053622,
+		0x74F136FD, 0xD9DA5BEF, 0x22648074, 0x8F4FED66,
+		0x0A1E801B, 0xA735ED09, 0x5C8B3692, 0xF1A05B80,
+		0xA1545B5F, 0x0C7F364D, 0xF7C1EDD6, 0x5AEA80C4,
+		0xDAB4ADB4, 0x779FC0A6, 0x8C211B3D, 0x210A762F,
+		0x71FE76F0, 0xDCD51BE2, 0x276BC079, 0x8A40AD6B,
+		0x0F11C016, 0xA23AAD04, 0x5984769F, 0xF4AF1B8D,
+		0xA45B1B52, 0x09707640, 0xF2CEADDB, 0x5FE5C0C9,
+		0xB0661B65, 0x1D4D7677, 0xE6F3ADEC, 0x4BD8C0FE,
+		0x1B2CC021, 0xB607AD33, 0x4DB976A8, 0xE0921BBA,
+		0x65C376C7, 0xC8E81BD5, 0x3356C04E, 0x9E7DAD5C,
+		0xCE89AD83, 0x63A2C091, 0x981C1B0A, 0x35377618,
+		0x6FDDF6DC, 0xC2F69BCE, 0x39484055, 0x94632D47,
+		0xC4972D98, 0x69BC408A, 0x92029B11, 0x3F29F603,
+		0xBA789B7E, 0x1753F66C, 0xECED2DF7, 0x41C640E5,
+		0x1132403A, 0xBC192D28, 0x47A7F6B3, 0xEA8C9BA1,
+		0x050F400D, 0xA8242D1F, 0x539AF684, 0xFEB19B96,
+		0xAE459B49, 0x036EF65B, 0xF8D02DC0, 0x55FB40D2,
+		0xD0AA2DAF, 0x7D8140BD, 0x863F9B26, 0x2B14F634,
+		0x7BE0F6EB, 0xD6CB9BF9, 0x2D754062, 0x805E2D70,
+		0x6D5A56DA, 0xC0713BC8, 0x3BCFE053, 0x96E48D41,
+		0xC6108D9E, 0x6B3BE08C, 0x90853B17, 0x3DAE5605,
+		0xB8FF3B78, 0x15D4566A, 0xEE6A8DF1, 0x4341E0E3,
+		0x13B5E03C, 0xBE9E8D2E, 0x452056B5, 0xE80B3BA7,
+		0x0788E00B, 0xAAA38D19, 0x511D5682, 0xFC363B90,
+		0xACC23B4F, 0x01E9565D, 0xFA578DC6, 0x577CE0D4,
+		0xD22D8DA9, 0x7F06E0BB, 0x84B83B20, 0x29935632,
+		0x796756ED, 0xD44C3BFF, 0x2FF2E064, 0x82D98D76,
+		0xD8330DB2, 0x751860A0, 0x8EA6BB3B, 0x238DD629,
+		0x7379D6F6, 0xDE52BBE4, 0x25EC607F, 0x88C70D6D,
+		0x0D966010, 0xA0BD0D02, 0x5B03D699, 0xF628BB8B,
+		0xA6DCBB54, 0x0BF7D646, 0xF0490DDD, 0x5D6260CF,
+		0xB2E1BB63, 0x1FCAD671, 0xE4740DEA, 0x495F60F8,
+		0x19AB6027, 0xB4800D35, 0x4F3ED6AE, 0xE215BBBC,
+		0x6744D6C1, 0xCA6FBBD3, 0x31D16048, 0x9CFA0D5A,
+		0xCC0E0D85, 0x61256097, 0x9A9BBB0C, 0x37B0D61E,
+		0xB7EEFB6E, 0x1AC5967C, 0xE17B4DE7, 0x4C5020F5,
+		0x1CA4202A, 0xB18F4D38, 0x4A3196A3, 0xE71AFBB1,
+		0x624B96CC, 0xCF60FBDE, 0x34DE2045, 0x99F54D57,
+		0xC9014D88, 0x642A209A, 0x9F94FB01, 0x32BF9613,
+		0xDD3C4DBF, 0x701720AD, 0x8BA9FB36, 0x26829624,
+		0x767696FB, 0xDB5DFBE9, 0x20E32072, 0x8DC84D60,
+		0x0899201D, 0xA5B24D0F, 0x5E0C9694, 0xF327FB86,
+		0xA3D3FB59, 0x0EF8964B, 0xF5464DD0, 0x586D20C2,
+		0x0287A006, 0xAFACCD14, 0x5412168F, 0xF9397B9D,
+		0xA9CD7B42, 0x04E61650, 0xFF58CDCB, 0x5273A0D9,
+		0xD722CDA4, 0x7A09A0B6, 0x81B77B2D, 0x2C9C163F,
+		0x7C6816E0, 0xD1437BF2, 0x2AFDA069, 0x87D6CD7B,
+		0x685516D7, 0xC57E7BC5, 0x3EC0A05E, 0x93EBCD4C,
+		0xC31FCD93, 0x6E34A081, 0x958A7B1A, 0x38A11608,
+		0xBDF07B75, 0x10DB1667, 0xEB65CDFC, 0x464EA0EE,
+		0x16BAA031, 0xBB91CD23, 0x402F16B8, 0xED047BAA
+	},
+	{
+		0x00000000, 0x2B6D12AD, 0x95B68956, 0xBEDB9BFB,
+		0x4ADB44AB, 0x61B65606, 0xDF6DCDFD, 0xF400DF50,
+		0xA56DA255, 0x8E00B0F8, 0x30DB2B03, 0x1BB639AE,
+		0xEFB6E6FE, 0xC4DBF453, 0x7A006FA8, 0x516D7D05,
+		0xD2B6D12A, 0xF9DBC387, 0x4700587C, 0x6C6D4AD1,
+		0x986D9581, 0xB300872C, 0x0DDB1CD7, 0x26B60E7A,
+		0x77DB737F, 0x5CB661D2, 0xE26DFA29, 0xC900E884,
+		0x3D0037D4, 0x166D2579, 0xA8B6BE82, 0x83DBAC2F,
+		0x695B6895, 0x42367A38, 0xFCEDE1C3, 0xD780F36E,
+		0x23802C3E, 0x08ED3E93, 0xB636A568, 0x9D5BB7C5,
+		0xCC36CAC0, 0xE75BD86D, 0x59804396, 0x72ED513B,
+		0x86ED8E6B, 0xAD809CC6, 0x135B073D, 0x38361590,
+		0xBBEDB9BF, 0x9080AB12, 0x2E5B30E9, 0x05362244,
+		0xF136FD14, 0xDA5BEFB9, 0x64807442, 0x4FED66EF,
+		0x1E801BEA, 0x35ED0947, 0x8B3692BC, 0xA05B8011,
+		0x545B5F41, 0x7F364DEC, 0xC1EDD617, 0xEA80C4BA,
+		0xB4ADB44A, 0x9FC0A6E7, 0x211B3D1C, 0x0A762FB1,
+		0xFE76F0E1, 0xD51BE24C, 0x6BC079B7, 0x40AD6B1A,
+		0x11C0161F, 0x3AAD04B2, 0x84769F49, 0xAF1B8DE4,
+		0x5B1B52B4, 0x70764019, 0xCEADDBE2, 0xE5C0C94F,
+		0x661B6560, 0x4D7677CD, 0xF3ADEC36, 0xD8C0FE9B,
+		0x2CC021CB, 0x07AD3366, 0xB976A89D, 0x921BBA30,
+		0xC376C735, 0xE81BD598, 0x56C04E63, 0x7DAD5CCE,
+		0x89AD839E, 0xA2C09133, 0x1C1B0AC8, 0x37761865,
+		0xDDF6DCDF, 0xF69BCE72, 0x48405589, 0x632D4724,
+		0x972D9874, 0xBC408AD9, 0x029B1122, 0x29F6038F,
+		0x789B7E8A, 0x53F66C27, 0xED2DF7DC, 0xC640E571,
+		0x32403A21, 0x192D288C, 0xA7F6B377, 0x8C9BA1DA,
+		0x0F400DF5, 0x242D1F58, 0x9AF684A3, 0xB19B960E,
+		0x459B495E, 0x6EF65BF3, 0xD02DC008, 0xFB40D2A5,
+		0xAA2DAFA0, 0x8140BD0D, 0x3F9B26F6, 0x14F6345B,
+		0xE0F6EB0B, 0xCB9BF9A6, 0x7540625D, 0x5E2D70F0,
+		0x5A56DA25, 0x713BC888, 0xCFE05373, 0xE48D41DE,
+		0x108D9E8E, 0x3BE08C23, 0x853B17D8, 0xAE560575,
+		0xFF3B7870, 0xD4566ADD, 0x6A8DF126, 0x41E0E38B,
+		0xB5E03CDB, 0x9E8D2E76, 0x2056B58D, 0x0B3BA720,
+		0x88E00B0F, 0xA38D19A2, 0x1D568259, 0x363B90F4,
+		0xC23B4FA4, 0xE9565D09, 0x578DC6F2, 0x7CE0D45F,
+		0x2D8DA95A, 0x06E0BBF7, 0xB83B200C, 0x935632A1,
+		0x6756EDF1, 0x4C3BFF5C, 0xF2E064A7, 0xD98D760A,
+		0x330DB2B0, 0x1860A01D, 0xA6BB3BE6, 0x8DD6294B,
+		0x79D6F61B, 0x52BBE4B6, 0xEC607F4D, 0xC70D6DE0,
+		0x966010E5, 0xBD0D0248, 0x03D699B3, 0x28BB8B1E,
+		0xDCBB544E, 0xF7D646E3, 0x490DDD18, 0x6260CFB5,
+		0xE1BB639A, 0xCAD67137, 0x740DEACC, 0x5F60F861,
+		0xAB602731, 0x800D359C, 0x3ED6AE67, 0x15BBBCCA,
+		0x44D6C1CF, 0x6FBBD362, 0xD1604899, 0xFA0D5A34,
+		0x0E0D8564, 0x256097C9, 0x9BBB0C32, 0xB0D61E9F,
+		0xEEFB6E6F, 0xC5967CC2, 0x7B4DE739, 0x5020F594,
+		0xA4202AC4, 0x8F4D3869, 0x3196A392, 0x1AFBB13F,
+		0x4B96CC3A, 0x60FBDE97, 0xDE20456C, 0xF54D57C1,
+		0x014D8891, 0x2A209A3C, 0x94FB01C7, 0xBF96136A,
+		0x3C4DBF45, 0x1720ADE8, 0xA9FB3613, 0x829624BE,
+		0x7696FBEE, 0x5DFBE943, 0xE32072B8, 0xC84D6015,
+		0x99201D10, 0xB24D0FBD, 0x0C969446, 0x27FB86EB,
+		0xD3FB59BB, 0xF8964B16, 0x464DD0ED, 0x6D20C240,
+		0x87A006FA, 0xACCD1457, 0x12168FAC, 0x397B9D01,
+		0xCD7B4251, 0xE61650FC, 0x58CDCB07, 0x73A0D9AA,
+		0x22CDA4AF, 0x09A0B602, 0xB77B2DF9, 0x9C163F54,
+		0x6816E004, 0x437BF2A9, 0xFDA06952, 0xD6CD7BFF,
+		0x5516D7D0, 0x7E7BC57D, 0xC0A05E86, 0xEBCD4C2B,
+		0x1FCD937B, 0x34A081D6, 0x8A7B1A2D, 0xA1160880,
+		0xF07B7585, 0xDB166728, 0x65CDFCD3, 0x4EA0EE7E,
+		0xBAA0312E, 0x91CD2383, 0x2F16B878, 0x047BAAD5
+	},
+	{
+		0x00000000, 0x6D12AD87, 0xB68956C3, 0xDB9BFB44,
+		0xDB44AB61, 0xB65606E6, 0x6DCDFDA2, 0x00DF5025,
+		0x6DA255B0, 0x00B0F837, 0xDB2B0373, 0xB639AEF4,
+		0xB6E6FED1, 0xDBF45356, 0x006FA812, 0x6D7D0595,
+		0xB6D12AD8, 0xDBC3875F, 0x00587C1B, 0x6D4AD19C,
+		0x6D9581B9, 0x00872C3E, 0xDB1CD77A, 0xB60E7AFD,
+		0xDB737F68, 0xB661D2EF, 0x6DFA29AB, 0x00E8842C,
+		0x0037D409, 0x6D25798E, 0xB6BE82CA, 0xDBAC2F4D,
+		0x5B68956C, 0x367A38EB, 0xEDE1C3AF, 0x80F36E28,
+		0x802C3E0D, 0xED3E938A, 0x36A568CE, 0x5BB7C549,
+		0x36CAC0DC, 0x5BD86D5B, 0x8043961F, 0xED513B98,
+		0xED8E6BBD, 0x809CC63A, 0x5B073D7E, 0x361590F9,
+		0xEDB9BFB4, 0x80AB1233, 0x5B30E977, 0x362244F0,
+		0x36FD14D5, 0x5BEFB952, 0x80744216, 0xED66EF91,
+		0x801BEA04, 0xED094783, 0x3692BCC7, 0x5B801140,
+		0x5B5F4165, 0x364DECE2, 0xEDD617A6, 0x80C4BA21,
+		0xADB44AB6, 0xC0A6E731, 0x1B3D1C75, 0x762FB1F2,
+		0x76F0E1D7, 0x1BE24C50, 0xC079B714, 0xAD6B1A93,
+		0xC0161F06, 0xAD04B281, 0x769F49C5, 0x1B8DE442,
+		0x1B52B467, 0x764019E0, 0xADDBE2A4, 0xC0C94F23,
+		0x1B65606E, 0x7677CDE9, 0xADEC36AD, 0xC0FE9B2A,
+		0xC021CB0F, 0xAD336688, 0x76A89DCC, 0x1BBA304B,
+		0x76C735DE, 0x1BD59859, 0xC04E631D, 0xAD5CCE9A,
+		0xAD839EBF, 0xC0913338, 0x1B0AC87C, 0x761865FB,
+		0xF6DCDFDA, 0x9BCE725D, 0x40558919, 0x2D47249E,
+		0x2D9874BB, 0x408AD93C, 0x9B112278, 0xF6038FFF,
+		0x9B7E8A6A, 0xF66C27ED, 0x2DF7DCA9, 0x40E5712E,
+		0x403A210B, 0x2D288C8C, 0xF6B377C8, 0x9BA1DA4F,
+		0x400DF502, 0x2D1F5885, 0xF684A3C1, 0x9B960E46,
+		0x9B495E63, 0xF65BF3E4, 0x2DC008A0, 0x40D2A527,
+		0x2DAFA0B2, 0x40BD0D35, 0x9B26F671, 0xF6345BF6,
+		0xF6EB0BD3, 0x9BF9A654, 0x40625D10, 0x2D70F097,
+		0x56DA255B, 0x3BC888DC, 0xE0537398, 0x8D41DE1F,
+		0x8D9E8E3A, 0xE08C23BD, 0x3B17D8F9, 0x5605757E,
+		0x3B7870EB, 0x566ADD6C, 0x8DF12628, 0xE0E38BAF,
+		0xE03CDB8A, 0x8D2E760D, 0x56B58D49, 0x3BA720CE,
+		0xE00B0F83, 0x8D19A204, 0x56825940, 0x3B90F4C7,
+		0x3B4FA4E2, 0x565D0965, 0x8DC6F221, 0xE0D45FA6,
+		0x8DA95A33, 0xE0BBF7B4, 0x3B200CF0, 0x5632A177,
+		0x56EDF152, 0x3BFF5CD5, 0xE064A791, 0x8D760A16,
+		0x0DB2B037, 0x60A01DB0, 0xBB3BE6F4, 0xD6294B73,
+		0xD6F61B56, 0xBBE4B6D1, 0x607F4D95, 0x0D6DE012,
+		0x6010E587, 0x0D024800, 0xD699B344, 0xBB8B1EC3,
+		0xBB544EE6, 0xD646E361, 0x0DDD1825, 0x60CFB5A2,
+		0xBB639AEF, 0xD6713768, 0x0DEACC2C, 0x60F861AB,
+		0x6027318E, 0x0D359C09, 0xD6AE674D, 0xBBBCCACA,
+		0xD6C1CF5F, 0xBBD362D8, 0x6048999C, 0x0D5A341B,
+		0x0D85643E, 0x6097C9B9, 0xBB0C32FD, 0xD61E9F7A,
+		0xFB6E6FED, 0x967CC26A, 0x4DE7392E, 0x20F594A9,
+		0x202AC48C, 0x4D38690B, 0x96A3924F, 0xFBB13FC8,
+		0x96CC3A5D, 0xFBDE97DA, 0x20456C9E, 0x4D57C119,
+		0x4D88913C, 0x209A3CBB, 0xFB01C7FF, 0x96136A78,
+		0x4DBF4535, 0x20ADE8B2, 0xFB3613F6, 0x9624BE71,
+		0x96FBEE54, 0xFBE943D3, 0x2072B897, 0x4D601510,
+		0x201D1085, 0x4D0FBD02, 0x96944646, 0xFB86EBC1,
+		0xFB59BBE4, 0x964B1663, 0x4DD0ED27, 0x20C240A0,
+		0xA006FA81, 0xCD145706, 0x168FAC42, 0x7B9D01C5,
+		0x7B4251E0, 0x1650FC67, 0xCDCB0723, 0xA0D9AAA4,
+		0xCDA4AF31, 0xA0B602B6, 0x7B2DF9F2, 0x163F5475,
+		0x16E00450, 0x7BF2A9D7, 0xA0695293, 0xCD7BFF14,
+		0x16D7D059, 0x7BC57DDE, 0xA05E869A, 0xCD4C2B1D,
+		0xCD937B38, 0xA081D6BF, 0x7B1A2DFB, 0x1608807C,
+		0x7B7585E9, 0x1667286E, 0xCDFCD32A, 0xA0EE7EAD,
+		0xA0312E88, 0xCD23830F, 0x16B8784B, 0x7BAAD5CC
+	},
+	{
+		0x00000000, 0x12AD8700, 0x8956C380, 0x9BFB4480,
+		0x44AB61C0, 0x5606E6C0, 0xCDFDA240, 0xDF502540,
+		0xA255B0E0, 0xB0F837E0, 0x2B037360, 0x39AEF460,
+		0xE6FED120, 0xF4535620, 0x6FA812A0, 0x7D0595A0,
+		0xD12AD870, 0xC3875F70, 0x587C1BF0, 0x4AD19CF0,
+		0x9581B9B0, 0x872C3EB0, 0x1CD77A30, 0x0E7AFD30,
+		0x737F6890, 0x61D2EF90, 0xFA29AB10, 0xE8842C10,
+		0x37D40950, 0x25798E50, 0xBE82CAD0, 0xAC2F4DD0,
+		0x68956C38, 0x7A38EB38, 0xE1C3AFB8, 0xF36E28B8,
+		0x2C3E0DF8, 0x3E938AF8, 0xA568CE78, 0xB7C54978,
+		0xCAC0DCD8, 0xD86D5BD8, 0x43961F58, 0x513B9858,
+		0x8E6BBD18, 0x9CC63A18, 0x073D7E98, 0x1590F998,
+		0xB9BFB448, 0xAB123348, 0x30E977C8, 0x2244F0C8,
+		0xFD14D588, 0xEFB95288, 0x74421608, 0x66EF9108,
+		0x1BEA04A8, 0x094783A8, 0x92BCC728, 0x80114028,
+		0x5F416568, 0x4DECE268, 0xD617A6E8, 0xC4BA21E8,
+		0xB44AB61C, 0xA6E7311C, 0x3D1C759C, 0x2FB1F29C,
+		0xF0E1D7DC, 0xE24C50DC, 0x79B7145C, 0x6B1A935C,
+		0x161F06FC, 0x04B281FC, 0x9F49C57C, 0x8DE4427C,
+		0x52B4673C, 0x4019E03C, 0xDBE2A4BC, 0xC94F23BC,
+		0x65606E6C, 0x77CDE96C, 0xEC36ADEC, 0xFE9B2AEC,
+		0x21CB0FAC, 0x336688AC, 0xA89DCC2C, 0xBA304B2C,
+		0xC735DE8C, 0xD598598C, 0x4E631D0C, 0x5CCE9A0C,
+		0x839EBF4C, 0x9133384C, 0x0AC87CCC, 0x1865FBCC,
+		0xDCDFDA24, 0xCE725D24, 0x558919A4, 0x47249EA4,
+		0x9874BBE4, 0x8AD93CE4, 0x11227864, 0x038FFF64,
+		0x7E8A6AC4, 0x6C27EDC4, 0xF7DCA944, 0xE5712E44,
+		0x3A210B04, 0x288C8C04, 0xB377C884, 0xA1DA4F84,
+		0x0DF50254, 0x1F588554, 0x84A3C1D4, 0x960E46D4,
+		0x495E6394, 0x5BF3E494, 0xC008A014, 0xD2A52714,
+		0xAFA0B2B4, 0xBD0D35B4, 0x26F67134, 0x345BF634,
+		0xEB0BD374, 0xF9A65474, 0x625D10F4, 0x70F097F4,
+		0xDA255B0E, 0xC888DC0E, 0x5373988E, 0x41DE1F8E,
+		0x9E8E3ACE, 0x8C23BDCE, 0x17D8F94E, 0x05757E4E,
+		0x7870EBEE, 0x6ADD6CEE, 0xF126286E, 0xE38BAF6E,
+		0x3CDB8A2E, 0x2E760D2E, 0xB58D49AE, 0xA720CEAE,
+		0x0B0F837E, 0x19A2047E, 0x825940FE, 0x90F4C7FE,
+		0x4FA4E2BE, 0x5D0965BE, 0xC6F2213E, 0xD45FA63E,
+		0xA95A339E, 0xBBF7B49E, 0x200CF01E, 0x32A1771E,
+		0xEDF1525E, 0xFF5CD55E, 0x64A791DE, 0x760A16DE,
+		0xB2B03736, 0xA01DB036, 0x3BE6F4B6, 0x294B73B6,
+		0xF61B56F6, 0xE4B6D1F6, 0x7F4D9576, 0x6DE01276,
+		0x10E587D6, 0x024800D6, 0x99B34456, 0x8B1EC356,
+		0x544EE616, 0x46E36116, 0xDD182596, 0xCFB5A296,
+		0x639AEF46, 0x71376846, 0xEACC2CC6, 0xF861ABC6,
+		0x27318E86, 0x359C0986, 0xAE674D06, 0xBCCACA06,
+		0xC1CF5FA6, 0xD362D8A6, 0x48999C26, 0x5A341B26,
+		0x85643E66, 0x97C9B966, 0x0C32FDE6, 0x1E9F7AE6,
+		0x6E6FED12, 0x7CC26A12, 0xE7392E92, 0xF594A992,
+		0x2AC48CD2, 0x38690BD2, 0xA3924F52, 0xB13FC852,
+		0xCC3A5DF2, 0xDE97DAF2, 0x456C9E72, 0x57C11972,
+		0x88913C32, 0x9A3CBB32, 0x01C7FFB2, 0x136A78B2,
+		0xBF453562, 0xADE8B262, 0x3613F6E2, 0x24BE71E2,
+		0xFBEE54A2, 0xE943D3A2, 0x72B89722, 0x60151022,
+		0x1D108582, 0x0FBD0282, 0x94464602, 0x86EBC102,
+		0x59BBE442, 0x4B166342, 0xD0ED27C2, 0xC240A0C2,
+		0x06FA812A, 0x1457062A, 0x8FAC42AA, 0x9D01C5AA,
+		0x4251E0EA, 0x50FC67EA, 0xCB07236A, 0xD9AAA46A,
+		0xA4AF31CA, 0xB602B6CA, 0x2DF9F24A, 0x3F54754A,
+		0xE004500A, 0xF2A9D70A, 0x6952938A, 0x7BFF148A,
+		0xD7D0595A, 0xC57DDE5A, 0x5E869ADA, 0x4C2B1DDA,
+		0x937B389A, 0x81D6BF9A, 0x1A2DFB1A, 0x08807C1A,
+		0x7585E9BA, 0x67286EBA, 0xFCD32A3A, 0xEE7EAD3A,
+		0x312E887A, 0x23830F7A, 0xB8784BFA, 0xAAD5CCFA
+	},
+	{
+		0x00000000, 0x000000A1, 0x00000050, 0x000000F1,
+		0x00000028, 0x00000089, 0x00000078, 0x000000D9,
+		0x00000014, 0x000000B5, 0x00000044, 0x000000E5,
+		0x0000003C, 0x0000009D, 0x0000006C, 0x000000CD,
+		0x0000000A, 0x000000AB, 0x0000005A, 0x000000FB,
+		0x00000022, 0x00000083, 0x00000072, 0x000000D3,
+		0x0000001E, 0x000000BF, 0x0000004E, 0x000000EF,
+		0x00000036, 0x00000097, 0x00000066, 0x000000C7,
+		0x00000005, 0x000000A4, 0x00000055, 0x000000F4,
+		0x0000002D, 0x0000008C, 0x0000007D, 0x000000DC,
+		0x00000011, 0x000000B0, 0x00000041, 0x000000E0,
+		0x00000039, 0x00000098, 0x00000069, 0x000000C8,
+		0x0000000F, 0x000000AE, 0x0000005F, 0x000000FE,
+		0x00000027, 0x00000086, 0x00000077, 0x000000D6,
+		0x0000001B, 0x000000BA, 0x0000004B, 0x000000EA,
+		0x00000033, 0x00000092, 0x00000063, 0x000000C2,
+		0x00000002, 0x000000A3, 0x00000052, 0x000000F3,
+		0x0000002A, 0x0000008B, 0x0000007A, 0x000000DB,
+		0x00000016, 0x000000B7, 0x00000046, 0x000000E7,
+		0x0000003E, 0x0000009F, 0x0000006E, 0x000000CF,
+		0x00000008, 0x000000A9, 0x00000058, 0x000000F9,
+		0x00000020, 0x00000081, 0x00000070, 0x000000D1,
+		0x0000001C, 0x000000BD, 0x0000004C, 0x000000ED,
+		0x00000034, 0x00000095, 0x00000064, 0x000000C5,
+		0x00000007, 0x000000A6, 0x00000057, 0x000000F6,
+		0x0000002F, 0x0000008E, 0x0000007F, 0x000000DE,
+		0x00000013, 0x000000B2, 0x00000043, 0x000000E2,
+		0x0000003B, 0x0000009A, 0x0000006B, 0x000000CA,
+		0x0000000D, 0x000000AC, 0x0000005D, 0x000000FC,
+		0x00000025, 0x00000084, 0x00000075, 0x000000D4,
+		0x00000019, 0x000000B8, 0x00000049, 0x000000E8,
+		0x00000031, 0x00000090, 0x00000061, 0x000000C0,
+		0x00000001, 0x000000A0, 0x00000051, 0x000000F0,
+		0x00000029, 0x00000088, 0x00000079, 0x000000D8,
+		0x00000015, 0x000000B4, 0x00000045, 0x000000E4,
+		0x0000003D, 0x0000009C, 0x0000006D, 0x000000CC,
+		0x0000000B, 0x000000AA, 0x0000005B, 0x000000FA,
+		0x00000023, 0x00000082, 0x00000073, 0x000000D2,
+		0x0000001F, 0x000000BE, 0x0000004F, 0x000000EE,
+		0x00000037, 0x00000096, 0x00000067, 0x000000C6,
+		0x00000004, 0x000000A5, 0x00000054, 0x000000F5,
+		0x0000002C, 0x0000008D, 0x0000007C, 0x000000DD,
+		0x00000010, 0x000000B1, 0x00000040, 0x000000E1,
+		0x00000038, 0x00000099, 0x00000068, 0x000000C9,
+		0x0000000E, 0x000000AF, 0x0000005E, 0x000000FF,
+		0x00000026, 0x00000087, 0x00000076, 0x000000D7,
+		0x0000001A, 0x000000BB, 0x0000004A, 0x000000EB,
+		0x00000032, 0x00000093, 0x00000062, 0x000000C3,
+		0x00000003, 0x000000A2, 0x00000053, 0x000000F2,
+		0x0000002B, 0x0000008A, 0x0000007B, 0x000000DA,
+		0x00000017, 0x000000B6, 0x00000047, 0x000000E6,
+		0x0000003F, 0x0000009E, 0x0000006F, 0x000000CE,
+		0x00000009, 0x000000A8, 0x00000059, 0x000000F8,
+		0x00000021, 0x00000080, 0x00000071, 0x000000D0,
+		0x0000001D, 0x000000BC, 0x0000004D, 0x000000EC,
+		0x00000035, 0x00000094, 0x00000065, 0x000000C4,
+		0x00000006, 0x000000A7, 0x00000056, 0x000000F7,
+		0x0000002E, 0x0000008F, 0x0000007E, 0x000000DF,
+		0x00000012, 0x000000B3, 0x00000042, 0x000000E3,
+		0x0000003A, 0x0000009B, 0x0000006A, 0x000000CB,
+		0x0000000C, 0x000000AD, 0x0000005C, 0x000000FD,
+		0x00000024, 0x00000085, 0x00000074, 0x000000D5,
+		0x00000018, 0x000000B9, 0x00000048, 0x000000E9,
+		0x00000030, 0x00000091, 0x00000060, 0x000000C1
+	},
+	{
+		0x00000000, 0x0000A100, 0x00005080, 0x0000F180,
+		0x00002840, 0x00008940, 0x000078C0, 0x0000D9C0,
+		0x00001420, 0x0000B520, 0x000044A0, 0x0000E5A0,
+		0x00003C60, 0x00009D60, 0x00006CE0, 0x0000CDE0,
+		0x00000A10, 0x0000AB10, 0x00005A90, 0x0000FB90,
+		0x00002250, 0x00008350, 0x000072D0, 0x0000D3D0,
+		0x00001E30, 0x0000BF30, 0x00004EB0, 0x0000EFB0,
+		0x00003670, 0x00009770, 0x000066F0, 0x0000C7F0,
+		0x00000508, 0x0000A408, 0x00005588, 0x0000F488,
+		0x00002D48, 0x00008C48, 0x00007DC8, 0x0000DCC8,
+		0x00001128, 0x0000B028, 0x000041A8, 0x0000E0A8,
+		0x00003968, 0x00009868, 0x000069E8, 0x0000C8E8,
+		0x00000F18, 0x0000AE18, 0x00005F98, 0x0000FE98,
+		0x00002758, 0x00008658, 0x000077D8, 0x0000D6D8,
+		0x00001B38, 0x0000BA38, 0x00004BB8, 0x0000EAB8,
+		0x00003378, 0x00009278, 0x000063F8, 0x0000C2F8,
+		0x00000284, 0x0000A384, 0x00005204, 0x0000F304,
+		0x00002AC4, 0x00008BC4, 0x00007A44, 0x0000DB44,
+		0x000016A4, 0x0000B7A4, 0x00004624, 0x0000E724,
+		0x00003EE4, 0x00009FE4, 0x00006E64, 0x0000CF64,
+		0x00000894, 0x0000A994, 0x00005814, 0x0000F914,
+		0x000020D4, 0x000081D4, 0x00007054, 0x0000D154,
+		0x00001CB4, 0x0000BDB4, 0x00004C34, 0x0000ED34,
+		0x000034F4, 0x000095F4, 0x00006474, 0x0000C574,
+		0x0000078C, 0x0000A68C, 0x0000570C, 0x0000F60C,
+		0x00002FCC, 0x00008ECC, 0x00007F4C, 0x0000DE4C,
+		0x000013AC, 0x0000B2AC, 0x0000432C, 0x0000E22C,
+		0x00003BEC, 0x00009AEC, 0x00006B6C, 0x0000CA6C,
+		0x00000D9C, 0x0000AC9C, 0x00005D1C, 0x0000FC1C,
+		0x000025DC, 0x000084DC, 0x0000755C, 0x0000D45C,
+		0x000019BC, 0x0000B8BC, 0x0000493C, 0x0000E83C,
+		0x000031FC, 0x000090FC, 0x0000617C, 0x0000C07C,
+		0x00000142, 0x0000A042, 0x000051C2, 0x0000F0C2,
+		0x00002902, 0x00008802, 0x00007982, 0x0000D882,
+		0x00001562, 0x0000B462, 0x000045E2, 0x0000E4E2,
+		0x00003D22, 0x00009C22, 0x00006DA2, 0x0000CCA2,
+		0x00000B52, 0x0000AA52, 0x00005BD2, 0x0000FAD2,
+		0x00002312, 0x00008212, 0x00007392, 0x0000D292,
+		0x00001F72, 0x0000BE72, 0x00004FF2, 0x0000EEF2,
+		0x00003732, 0x00009632, 0x000067B2, 0x0000C6B2,
+		0x0000044A, 0x0000A54A, 0x000054CA, 0x0000F5CA,
+		0x00002C0A, 0x00008D0A, 0x00007C8A, 0x0000DD8A,
+		0x0000106A, 0x0000B16A, 0x000040EA, 0x0000E1EA,
+		0x0000382A, 0x0000992A, 0x000068AA, 0x0000C9AA,
+		0x00000E5A, 0x0000AF5A, 0x00005EDA, 0x0000FFDA,
+		0x0000261A, 0x0000871A, 0x0000769A, 0x0000D79A,
+		0x00001A7A, 0x0000BB7A, 0x00004AFA, 0x0000EBFA,
+		0x0000323A, 0x0000933A, 0x000062BA, 0x0000C3BA,
+		0x000003C6, 0x0000A2C6, 0x00005346, 0x0000F246,
+		0x00002B86, 0x00008A86, 0x00007B06, 0x0000DA06,
+		0x000017E6, 0x0000B6E6, 0x00004766, 0x0000E666,
+		0x00003FA6, 0x00009EA6, 0x00006F26, 0x0000CE26,
+		0x000009D6, 0x0000A8D6, 0x00005956, 0x0000F856,
+		0x00002196, 0x00008096, 0x00007116, 0x0000D016,
+		0x00001DF6, 0x0000BCF6, 0x00004D76, 0x0000EC76,
+		0x000035B6, 0x000094B6, 0x00006536, 0x0000C436,
+		0x000006CE, 0x0000A7CE, 0x0000564E, 0x0000F74E,
+		0x00002E8E, 0x00008F8E, 0x00007E0E, 0x0000DF0E,
+		0x000012EE, 0x0000B3EE, 0x0000426E, 0x0000E36E,
+		0x00003AAE, 0x00009BAE, 0x00006A2E, 0x0000CB2E,
+		0x00000CDE, 0x0000ADDE, 0x00005C5E, 0x0000FD5E,
+		0x0000249E, 0x0000859E, 0x0000741E, 0x0000D51E,
+		0x000018FE, 0x0000B9FE, 0x0000487E, 0x0000E97E,
+		0x000030BE, 0x000091BE, 0x0000603E, 0x0000C13E
+	}
+};
+
+uint32_t toeplitz(const uint8_t *key, const char *buf, size_t len)
+{
+	uint32_t result = 0;
+	uint32_t window = (key[0] << 24) | (key[1] << 16) | (key[2] << 8) | key[3];
+	
+	for (size_t byte = 0; byte < len; byte++)
+	{
+		for (int bit = 7; bit >= 0; bit--)
+		{
+			if (buf[byte] & (1 << bit))
+				result ^= window;
+			window = (window << 1) | ((key[byte + 4] >> bit) & 1);
+		}
+	}
+	return result;
+}
+
+uint32_t toeplitz_6(const char *buf)
+{
+	const uint8_t *bytes = reinterpret_cast<const uint8_t *>(buf);
+	
+	return table_toeplitz_6[0][bytes[0]] ^
+		table_toeplitz_6[1][bytes[1]] ^
+		table_toeplitz_6[2][bytes[2]] ^
+		table_toeplitz_6[3][bytes[3]] ^
+		table_toeplitz_6[4][bytes[4]] ^
+		table_toeplitz_6[5][bytes[5]];
+}
+
+String toeplitzRSSSettings(int queues)
+{
+	static const char hex[] = "0123456789abcdef";
+	String key;
+	
+	for (int i = 0; i < TOEPLITZ_KEY_LEN; i++)
+	{
+		if (i)
+			key += ':';
+		key += hex[TOEPLITZ_RSS_KEY[i] >> 4];
+		key += hex[TOEPLITZ_RSS_KEY[i] & 0xf];
+	}
+	return "hkey " + key + " equal " + String(queues) + "\nrx-flow-hash udp4 sdfn";
+}
+
+void toeplitz_6_batch(const HashTouple *touples, uint32_t *hashes, int count)
+{
+	for (int i = 0; i < count; i++)
+		hashes[i] = toeplitz_6(reinterpret_cast<const char *>(&touples[i]));
+}
+
+}
+
+CLICK_ENDDECLS
+
+ELEMENT_PROVIDES(Beamer_Toeplitz)
@@ -0,0 +1,51 @@
+#ifndef CLICK_BEAMER_TOEPLITZ_HH
+#define CLICK_BEAMER_TOEPLITZ_HH
+
+#include <click/config.h>
+#include <click/string.hh>
+#include "p4crc32.hh"
+
+CLICK_DECLS
+
+namespace Beamer
+{
+
+/* the key most NICs ship with for RSS */
+const int TOEPLITZ_KEY_LEN = 40;
+
+extern const uint8_t TOEPLITZ_DEFAULT_KEY[TOEPLITZ_KEY_LEN];
+
+/* RSS indirection tables of up to 2^TOEPLITZ_RSS_RETA_BITS entries line up with toeplitz_6() */
+const int TOEPLITZ_RSS_RETA_BITS = 9;
+
+/*
+ * For the NIC: under this key, the low TOEPLITZ_RSS_RETA_BITS bits of the
+ * RSS hash of a TCP or UDP over IPv4 packet don't depend on its
+ * destination, and match toeplitz_6() of its source.
+ */
+extern const uint8_t TOEPLITZ_RSS_KEY[TOEPLITZ_KEY_LEN];
+
+/* bit by bit; key must be at least len + 4 bytes long */
+uint32_t toeplitz(const uint8_t *key, const char *buf, size_t len);
+
+/*
+ * The RSS hash under TOEPLITZ_RSS_KEY of a touple's source address and
+ * port, with the destination ones zeroed; a table lookup per byte
+ */
+uint32_t toeplitz_6(const char *buf);
+
+/*
+ * Two lines: "hkey KEY equal QUEUES", what ethtool -X takes to line RSS up
+ * with toeplitz_6(), and "rx-flow-hash udp4 sdfn", what ethtool -N takes
+ * for UDP to be hashed on its ports like TCP is; many NICs only hash UDP
+ * on addresses by default, and then UDP flows land on the wrong slices.
+ */
+String toeplitzRSSSettings(int queues);
+
+void toeplitz_6_batch(const HashTouple *touples, uint32_t *hashes, int count);
+
+}
+
+CLICK_ENDDECLS
+
+#endif /* CLICK_BEAMER_TOEPLITZ_HH */
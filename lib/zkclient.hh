@@ -4,7 +4,11 @@
 #include <click/config.h>
 #include <click/string.hh>
 #include <click/glue.hh>
+#include <click/deque.hh>
+#include <click/vector.hh>
+#include <click/hashtable.hh>
 #include <zookeeper/zookeeper.h>
+#include <pthread.h>
 #include <zlib.h>
 #include "dipmap.hh"
 
@@ -30,7 +34,127 @@ template <typename DIP_MAP> class ZKClient
 		UPDATE_FROM_GEN,
 	};
 	
-	static const int BUF_SIZE = 100 * 1024 * 1024; /* 100 MB */
+	enum NodeKind
+	{
+		NODE_BLOB,
+		NODE_LOG,
+	};
+	
+	enum LogParseState
+	{
+		LOG_HEADER,
+		LOG_ENTRY,
+		LOG_BUCKETS,
+	};
+	
+	/*
+	 * A chunked node (name_0 .. name_N) being fetched asynchronously. Chunks
+	 * are inflated in order as soon as they arrive and decoded straight into
+	 * the map, so only a window's worth of compressed chunks is ever held.
+	 */
+	struct HugeNode
+	{
+		struct Chunk
+		{
+			char *data;
+			int size;
+			
+			Chunk()
+				: data(NULL), size(-1) {}
+		};
+		
+		NodeKind kind;
+		String name;
+		int32_t tag; /* blob or generation number */
+		int32_t chunkCount; /* -1 until chunk 0 tells us */
+		int issued;
+		int consumed;
+		int err;
+		Vector<Chunk> chunks;
+		
+		z_stream strm;
+		bool inflating;
+		bool streamEnded;
+		
+		/* a record straddling two inflate outputs */
+		char carry[64];
+		int carryLen;
+		
+		/* NODE_BLOB */
+		unsigned long entries;
+		
+		/* NODE_LOG */
+		bool coalesce; /* decode into the catch-up delta instead of the map */
+		LogParseState logState;
+		typename DIP_MAP::LogHeader logHeader;
+		LogEntry logEntry;
+		uint32_t bucketsLeft;
+		
+		HugeNode(NodeKind kind, const String &name, int32_t tag)
+			: kind(kind), name(name), tag(tag), chunkCount(-1), issued(0), consumed(0), err(ZOK), chunks(1, Chunk()),
+			  inflating(false), streamEnded(false), carryLen(0), entries(0), coalesce(false), logState(LOG_HEADER), bucketsLeft(0) {}
+		
+		~HugeNode()
+		{
+			for (int i = 0; i < chunks.size(); i++)
+				delete[] chunks[i].data;
+			if (inflating)
+				inflateEnd(&strm);
+		}
+		
+		/* append to carry until it holds want bytes */
+		bool gather(int want, const char **data, int *len)
+		{
+			int take = want - carryLen;
+			
+			if (take > *len)
+				take = *len;
+			memcpy(carry + carryLen, *data, take);
+			carryLen += take;
+			*data += take;
+			*len -= take;
+			
+			return carryLen == want;
+		}
+	};
+	
+	/* the net effect of several generations on one bucket */
+	struct DeltaEntry
+	{
+		uint32_t dip;
+		uint32_t prevDip; /* only if hasPrev; otherwise prev is whatever was current */
+		bool hasPrev;
+		typename DIP_MAP::LogHeader header;
+	};
+	
+	struct ReplayWorker
+	{
+		ZKClient<DIP_MAP> *me;
+		Vector<uint32_t> buckets;
+		Vector<DeltaEntry> entries;
+		pthread_t thread;
+	};
+	
+	struct FetchContext
+	{
+		ZKClient<DIP_MAP> *me;
+		unsigned int epoch;
+		HugeNode *node; /* only valid if epoch is current */
+		int chunk;
+		
+		FetchContext(ZKClient<DIP_MAP> *me, unsigned int epoch, HugeNode *node, int chunk)
+			: me(me), epoch(epoch), node(node), chunk(chunk) {}
+	};
+	
+	static const int INFLATE_BUF_SIZE = 256 * 1024;
+	
+	static const int DEFAULT_FETCH_WINDOW = 16;
+	
+	/* smaller deltas aren't worth spawning threads for */
+	static const int PARALLEL_REPLAY_THRESHOLD = 4096;
+	
+	/* flush the catch-up delta early past this many buckets */
+	static const int MAX_DELTA_SIZE = 1 << 22;
 	
 	const String LATEST_BLOB    = "latest_blob";
 	const String LATEST_GEN     = "latest_gen";
@@ -41,25 +165,59 @@ template <typename DIP_MAP> class ZKClient
 	DIP_MAP *dipMap;
 	volatile int32_t gen;
 	zhandle_t *zooHandle;
+	bool ownsHandle; /* false if attach()ed to someone else's session */
 	State state;
 	
 	int32_t latestGen;
 	int32_t latestBlob;
 	bool live;
 	
-	char *dataBuf;
-	char *nodeBuf;
+	char *inflateBuf;
+	
+	/*
+	 * Nodes are applied in queue order. At most fetchWindow chunks are in
+	 * flight or buffered at a time; one slot is always left for the node
+	 * at the front of the queue, so it can't be starved by later nodes.
+	 */
+	Deque<HugeNode *> fetchQueue;
+	int fetchWindow;
+	int inFlight;
+	int buffered;
+	unsigned int fetchEpoch; /* bumped to orphan outstanding requests */
+	int32_t lastQueuedGen;
+	
+	/*
+	 * When several generations are pending, their logs are merged into a
+	 * last-writer-wins delta and applied in one go, split by bucket range
+	 * across replayThreads threads. gen only advances once it's applied.
+	 */
+	HashTable<uint32_t, DeltaEntry> delta;
+	int32_t coalescedGen;
+	int replayThreads;
+	
+	/* held while the FSM runs; lets others see the map at a whole generation */
+	pthread_mutex_t updateLock;
+	
+	/* updates the map had no room for (see DIPMapBase::updateEntry()) */
+	unsigned long mapErrors;
+	
+	/* said once, counted always; replay workers get here concurrently */
+	void mapError(int err)
+	{
+		if (__atomic_fetch_add(&mapErrors, 1, __ATOMIC_RELAXED) == 0)
+			click_chatter("%s: %s", root.c_str(), strerror(-err));
+	}
 	
 	static void latestGenWatcher(zhandle_t *zh, int type, int state, const char *path, void *watcherCtx)
 	{
 		(void)zh; (void)type; (void)state;
 		
-		/* some other type of event; ignore */
-		if (!path)
-			return;
-		
 		ZKClient<DIP_MAP> *me = (ZKClient *)watcherCtx;
 		
+		/* some other type of event, or one for a client that's going away; ignore */
+		if (!path || !me->live)
+			return;
+		
 		int32_t newLatestGen = me->getInt32(me->root + me->LATEST_GEN, true);
 		
 		if (newLatestGen > me->latestGen)
@@ -69,19 +227,28 @@ template <typename DIP_MAP> class ZKClient
 			me->sync();
 	}
 	
-	static void syncComplete(int, const char *, const void *data)
+	static void syncComplete(int rc, const char *, const void *data)
 	{
 		ZKClient<DIP_MAP> *me = (ZKClient *)data;
 		
+		/* the session is closing; there's nothing left to read */
+		if (rc == ZCLOSING)
+			return;
+		
 		me->fsm();
 	}
 	
-	int readNode(String name, bool watch, char *buf, int *size)
+	/* returns whatever ZooKeeper says, for callers that can deal with errors */
+	int tryReadNode(String name, bool watch, char *buf, int *size)
 	{
-		int err;
+		/* watches are set per client, so that several can share a session */
+		return zoo_wget(zooHandle, name.c_str(), watch ? latestGenWatcher : NULL, this, buf, size, NULL);
+	}
 	
-		//click_chatter("zoo_get(%p, %s, %d, %p, %d, %p", zooHandle, name.c_str(), watch, buf, size, NULL);
-		err = zoo_get(zooHandle, name.c_str(), watch, buf, size, NULL);
+	int readNode(String name, bool watch, char *buf, int *size)
+	{
+		int err = tryReadNode(name, watch, buf, size);
+		
 		switch (err)
 		{
 		case ZOK:
@@ -93,142 +260,401 @@ template <typename DIP_MAP> class ZKClient
 		case ZINVALIDSTATE:
 		case ZMARSHALLINGERROR:
 		default:
-			click_chatter("zoo_get: %d", err);
+			click_chatter("zoo_wget: %d", err);
 			assert(false);
 		}
 		
 		return err;
 	}
 	
-	/* 
-	 * shamelessly copied from stackoverflow: 
-	 * https://stackoverflow.com/questions/4901842/in-memory-decompression-with-zlib 
-	 */
-	int inflatez(const void *src, int srcLen, void *dst, int dstLen)
+	static void fetchComplete(int rc, const char *value, int valueLen, const struct Stat *stat, const void *data)
 	{
-		z_stream strm  = {0};
-		strm.total_in  = strm.avail_in  = srcLen;
-		strm.total_out = strm.avail_out = dstLen;
-		strm.next_in   = (Bytef *) src;
-		strm.next_out  = (Bytef *) dst;
+		(void)stat;
 		
-		strm.zalloc = Z_NULL;
-		strm.zfree  = Z_NULL;
-		strm.opaque = Z_NULL;
+		FetchContext *ctx = (FetchContext *)data;
+		ZKClient<DIP_MAP> *me = ctx->me;
 		
-		int err = -1;
+		me->inFlight--;
 		
-		err = inflateInit2(&strm, (15 + 32)); //15 window bits, and the +32 tells zlib to to detect if using gzip or zlib
-		assert(err == Z_OK);
+		/* the session is closing: every pending fetch ends up here, and nothing may touch the handle */
+		if (rc == ZCLOSING)
+		{
+			delete ctx;
+			return;
+		}
+		
+		/* orphaned by a restart; nothing to do but free up the window */
+		if (ctx->epoch != me->fetchEpoch)
+		{
+			delete ctx;
+			me->pumpFetches();
+			return;
+		}
 		
-		err = inflate(&strm, Z_FINISH);
-		assert(err == Z_STREAM_END);
+		HugeNode *node = ctx->node;
 		
-		inflateEnd(&strm);
+		if (rc != ZOK)
+		{
+			if (rc != ZNONODE)
+				click_chatter("zoo_aget: %d", rc);
+			node->err = rc;
+		}
+		else
+		{
+			if (ctx->chunk == 0)
+			{
+				assert(valueLen >= (int)sizeof(int32_t));
+				node->chunkCount = *(reinterpret_cast<const int32_t *>(value));
+				assert(node->chunkCount >= 1);
+				node->chunks.resize(node->chunkCount, typename HugeNode::Chunk());
+			}
+			
+			typename HugeNode::Chunk *chunk = &node->chunks[ctx->chunk];
+			
+			chunk->data = new char[valueLen > 0 ? valueLen : 1]; assert(chunk->data);
+			memcpy(chunk->data, value, valueLen);
+			chunk->size = valueLen;
+			me->buffered++;
+		}
 		
-		return strm.total_out;
+		delete ctx;
+		me->fsm();
 	}
 	
-	int readCompressedNode(String name, bool watch, char *buf, int *size)
+	void issueFetch(HugeNode *node, int chunk)
 	{
-		int nodeSize = BUF_SIZE;
-		int err = readNode(name, watch, nodeBuf, &nodeSize);
+		FetchContext *ctx = new FetchContext(this, fetchEpoch, node, chunk); assert(ctx);
+		String path = node->name + "_" + String(chunk);
+		
+		int err = zoo_aget(zooHandle, path.c_str(), false, fetchComplete, ctx);
 		if (err != ZOK)
-			return err;
-		//click_chatter("inflating %s max %d", name.c_str(), *size);
-		*size = inflatez(nodeBuf, nodeSize, buf, *size);
-		//click_chatter("inflated %d", *size);
+		{
+			click_chatter("zoo_aget: %d", err);
+			assert(false);
+		}
 		
-		return err;
+		node->issued++;
+		inFlight++;
+	}
+	
+	/* keep the window full, in queue order */
+	void pumpFetches()
+	{
+		for (int i = 0; i < fetchQueue.size(); i++)
+		{
+			HugeNode *node = fetchQueue[i];
+			int limit = (i == 0) ? fetchWindow : fetchWindow - 1;
+			
+			if (node->err != ZOK || inFlight + buffered >= limit)
+				break;
+			
+			if (node->chunkCount < 0)
+			{
+				/* the rest of this node has to wait for chunk 0 */
+				if (node->issued == 0)
+					issueFetch(node, 0);
+				continue;
+			}
+			
+			while (node->issued < node->chunkCount && inFlight + buffered < limit)
+				issueFetch(node, node->issued);
+		}
+	}
+	
+	void queueFetch(NodeKind kind, const String &name, int32_t tag)
+	{
+		HugeNode *node = new HugeNode(kind, name, tag); assert(node);
 		
+		fetchQueue.push_back(node);
+	}
+	
+	void abortFetches()
+	{
+		fetchEpoch++;
+		buffered = 0;
+		while (fetchQueue.size())
+		{
+			delete fetchQueue.front();
+			fetchQueue.pop_front();
+		}
 	}
 	
-	int readHugeNode(String name, bool watch, char *buf, int *size)
+	String blobName(int32_t blobNo)
 	{
-		int32_t chunks;
-		int off = 0;
+		return root + GEN_BASE + "_" + String(blobNo) + "/" + BLOB_PART_BASE;
+	}
+	
+	String logName(int32_t index)
+	{
+		return root + GEN_BASE + "_" + String(index) + "/log";
+	}
+	
+	/* blob entries go to the map's staging copy, to be published once complete */
+	void consumeBlob(HugeNode *node, const char *data, int len)
+	{
+		typedef typename DIP_MAP::MapEntry MapEntry;
+		static const int ENTRY_SIZE = sizeof(MapEntry);
 		int err;
-
-		/* first node */
+		
+		if (node->carryLen > 0)
 		{
-			int nodeSize = BUF_SIZE;
-			err = readNode(name + "_0", watch, nodeBuf, &nodeSize);
-			if (err != ZOK)
-				return err;
-			off += nodeSize;
-			
-			assert(nodeSize >= sizeof(int32_t));
-			chunks = *(reinterpret_cast<int *>(nodeBuf));
-			assert(chunks >= 1);
+			if (!node->gather(ENTRY_SIZE, &data, &len))
+				return;
+			assert(node->entries < dipMap->size());
+			if ((err = dipMap->putStagedEntries(node->entries, reinterpret_cast<MapEntry *>(node->carry), 1)) < 0)
+				mapError(err);
+			node->entries++;
+			node->carryLen = 0;
 		}
 		
-		for (int i = 1; i < chunks; i++)
+		unsigned long count = len / ENTRY_SIZE;
+		
+		assert(node->entries + count <= dipMap->size());
+		if ((err = dipMap->putStagedEntries(node->entries, reinterpret_cast<MapEntry *>(const_cast<char *>(data)), count)) < 0)
+			mapError(err);
+		node->entries += count;
+		data += count * ENTRY_SIZE;
+		len -= count * ENTRY_SIZE;
+		
+		node->gather(ENTRY_SIZE, &data, &len);
+	}
+	
+	void coalesceUpdate(uint32_t bucket, uint32_t dip, const typename DIP_MAP::LogHeader &header)
+	{
+		typename HashTable<uint32_t, DeltaEntry>::iterator it = delta.find(bucket);
+		
+		if (it == delta.end())
 		{
-			int nodeSize = BUF_SIZE - off;
-			err = readNode(name + "_" + String(i), false, nodeBuf + off, &nodeSize);
-			if (err != ZOK)
-				return err;
-			off += nodeSize;
+			DeltaEntry entry;
+			
+			entry.dip = dip;
+			entry.prevDip = 0;
+			entry.hasPrev = false;
+			memcpy(&entry.header, &header, sizeof(header));
+			delta.set(bucket, entry);
 		}
-		*size = inflatez(nodeBuf + sizeof(int32_t), off - sizeof(int32_t), buf, *size);
+		else
+		{
+			/* replaying both writes in order would leave exactly this behind */
+			it.value().prevDip = it.value().dip;
+			it.value().hasPrev = true;
+			it.value().dip = dip;
+			memcpy(&it.value().header, &header, sizeof(header));
+		}
+	}
+	
+	static void *replayWorker(void *arg)
+	{
+		ReplayWorker *worker = (ReplayWorker *)arg;
+		DIP_MAP *dipMap = worker->me->dipMap;
 		
-		return err;
+		for (int i = 0; i < worker->buckets.size(); i++)
+		{
+			DeltaEntry &entry = worker->entries[i];
+			int err;
+			
+			if (entry.hasPrev)
+				err = dipMap->setEntry(worker->buckets[i], entry.dip, entry.prevDip, entry.header);
+			else
+				err = dipMap->updateEntry(worker->buckets[i], entry.dip, entry.header);
+			if (err < 0)
+				worker->me->mapError(err);
+		}
+		
+		return NULL;
 	}
 	
-	int installBlob(int32_t blobNo)
+	void flushDelta()
 	{
-		static const int ENTRY_SIZE = sizeof(typename DIP_MAP::MapEntry);
-		int size = BUF_SIZE;
+		if (coalescedGen <= gen)
+			return;
 		
-		int err = readHugeNode(root + GEN_BASE + "_" + String(blobNo) + "/" + BLOB_PART_BASE, false, dataBuf, &size);
-		if (err != ZOK)
-			return err;
-		assert(size % ENTRY_SIZE == 0);
-		assert(size / ENTRY_SIZE == dipMap->size());
+		int threads = delta.size() >= PARALLEL_REPLAY_THRESHOLD ? replayThreads : 1;
+		Vector<ReplayWorker> workers(threads, ReplayWorker());
+		int err;
 		
-		dipMap->putEntries(0, reinterpret_cast<typename DIP_MAP::MapEntry *>(dataBuf), dipMap->size());
-		gen = blobNo;
+		for (typename HashTable<uint32_t, DeltaEntry>::iterator it = delta.begin(); it != delta.end(); ++it)
+		{
+			int w = (unsigned long long)it.key() * threads / dipMap->size();
+			
+			/* maps may need to learn about new DIPs before writers go parallel */
+			if ((err = dipMap->prepareDIP(it.value().dip)) < 0)
+				mapError(err);
+			if (it.value().hasPrev && (err = dipMap->prepareDIP(it.value().prevDip)) < 0)
+				mapError(err);
+			
+			workers[w].buckets.push_back(it.key());
+			workers[w].entries.push_back(it.value());
+		}
+		delta.clear();
 		
-		//click_chatter("New gen from blob: %d", (int)gen);
+		for (int i = 0; i < threads; i++)
+			workers[i].me = this;
+		for (int i = 1; i < threads; i++)
+		{
+			int err = pthread_create(&workers[i].thread, NULL, replayWorker, &workers[i]);
+			assert(err == 0);
+		}
+		replayWorker(&workers[0]);
+		for (int i = 1; i < threads; i++)
+			pthread_join(workers[i].thread, NULL);
 		
-		return ZOK;
+		gen = coalescedGen;
+	}
+	
+	void discardDelta()
+	{
+		delta.clear();
+		coalescedGen = gen;
 	}
 	
-	int replayLog(int32_t index)
+	/* log entries are applied to the live map as they are decoded */
+	void consumeLog(HugeNode *node, const char *data, int len)
 	{
-		int size = BUF_SIZE;
-		int err = readHugeNode(root + GEN_BASE + "_" + String(index) + "/log", false, dataBuf, &size);
-		char *crt = dataBuf;
-		typename DIP_MAP::LogHeader *header;
+		int err;
 		
-		if (err != ZOK)
-			goto done;
+		while (len > 0)
+		{
+			switch (node->logState)
+			{
+			case LOG_HEADER:
+				if (!node->gather(sizeof(node->logHeader), &data, &len))
+					return;
+				memcpy(&node->logHeader, node->carry, sizeof(node->logHeader));
+				node->carryLen = 0;
+				node->logState = LOG_ENTRY;
+				break;
+				
+			case LOG_ENTRY:
+				if (!node->gather(sizeof(LogEntry), &data, &len))
+					return;
+				memcpy(&node->logEntry, node->carry, sizeof(LogEntry));
+				node->carryLen = 0;
+				node->bucketsLeft = node->logEntry.bucketCount;
+				if (node->bucketsLeft > 0)
+					node->logState = LOG_BUCKETS;
+				break;
+				
+			case LOG_BUCKETS:
+				while (node->bucketsLeft > 0 && len > 0)
+				{
+					uint32_t bucket;
+					
+					if (node->carryLen > 0 || len < (int)sizeof(uint32_t))
+					{
+						if (!node->gather(sizeof(uint32_t), &data, &len))
+							return;
+						memcpy(&bucket, node->carry, sizeof(uint32_t));
+						node->carryLen = 0;
+					}
+					else
+					{
+						memcpy(&bucket, data, sizeof(uint32_t));
+						data += sizeof(uint32_t);
+						len -= sizeof(uint32_t);
+					}
+					
+					assert(bucket < dipMap->size());
+					if (node->coalesce)
+						coalesceUpdate(bucket, node->logEntry.dip, node->logHeader);
+					else if ((err = dipMap->updateEntry(bucket, node->logEntry.dip, node->logHeader)) < 0)
+						mapError(err);
+					node->bucketsLeft--;
+				}
+				if (node->bucketsLeft == 0)
+					node->logState = LOG_ENTRY;
+				break;
+			}
+		}
+	}
+	
+	void inflateChunk(HugeNode *node, const char *data, int len)
+	{
+		if (!node->inflating)
+		{
+			memset(&node->strm, 0, sizeof(node->strm));
+			int err = inflateInit2(&node->strm, (15 + 32)); //15 window bits, and the +32 tells zlib to to detect if using gzip or zlib
+			assert(err == Z_OK);
+			node->inflating = true;
+		}
 		
-		header = reinterpret_cast<typename DIP_MAP::LogHeader *>(crt);
-		crt += sizeof(*header);
-		size -= sizeof(*header);
+		node->strm.next_in  = (Bytef *)data;
+		node->strm.avail_in = len;
 		
-		while (size > 0)
+		while (!node->streamEnded)
 		{
-			assert(size >= sizeof(LogEntry));
+			node->strm.next_out  = (Bytef *)inflateBuf;
+			node->strm.avail_out = INFLATE_BUF_SIZE;
 			
-			LogEntry *entry = reinterpret_cast<LogEntry *>(crt);
-			int logSize = sizeof(LogEntry) + entry->bucketCount * sizeof(uint32_t);
+			int err = inflate(&node->strm, Z_NO_FLUSH);
+			if (err == Z_BUF_ERROR) /* needs more input */
+				break;
+			assert(err == Z_OK || err == Z_STREAM_END);
 			
-			assert(size >= logSize);
+			int outLen = INFLATE_BUF_SIZE - node->strm.avail_out;
 			
-			for (int32_t i = 0; i < entry->bucketCount; i++)
-				dipMap->updateEntry(entry->buckets[i], entry->dip, *header);
+			if (node->kind == NODE_BLOB)
+				consumeBlob(node, inflateBuf, outLen);
+			else
+				consumeLog(node, inflateBuf, outLen);
 			
-			crt += logSize;
-			size -= logSize;
+			if (err == Z_STREAM_END)
+				node->streamEnded = true;
+			else if (node->strm.avail_in == 0 && node->strm.avail_out > 0)
+				break;
 		}
+	}
+	
+	/* feed whatever chunks have arrived in order; true once the node is fully applied */
+	bool drain(HugeNode *node)
+	{
+		if (node->chunkCount < 0)
+			return false;
 		
-done:
-		return err;
+		while (node->consumed < node->chunkCount)
+		{
+			typename HugeNode::Chunk *chunk = &node->chunks[node->consumed];
+			
+			if (chunk->size < 0)
+				return false;
+			
+			if (node->consumed == 0 && node->kind == NODE_BLOB)
+				dipMap->stage();
+			
+			/* chunk 0 starts with the chunk count */
+			int skip = (node->consumed == 0) ? sizeof(int32_t) : 0;
+			
+			inflateChunk(node, chunk->data + skip, chunk->size - skip);
+			
+			delete[] chunk->data;
+			chunk->data = NULL;
+			node->consumed++;
+			buffered--;
+		}
+		
+		assert(node->streamEnded);
+		assert(node->carryLen == 0);
+		if (node->kind == NODE_BLOB)
+			assert(node->entries == dipMap->size());
+		else
+			assert(node->logState != LOG_BUCKETS);
+		
+		return true;
 	}
 	
+	/*
+	 * Runs on the ZooKeeper completion thread only: from sync(), from the
+	 * latest_gen watcher (via sync()) and whenever a chunk arrives.
+	 */
 	void fsm()
+	{
+		pthread_mutex_lock(&updateLock);
+		if (live)
+			advance();
+		pthread_mutex_unlock(&updateLock);
+	}
+	
+	void advance()
 	{
 		/* commented syncs replaced with goto again */
 again:
@@ -236,6 +662,27 @@ again:
 		{
 		case INIT:
 			//TODO: set thread affinity
+			
+			/* warm start: the map already holds gen, so go straight for the logs */
+			if (gen >= 0)
+			{
+				int32_t newLatestGen = getInt32(root + LATEST_GEN, true);
+				
+				if (newLatestGen > latestGen)
+					latestGen = newLatestGen;
+				
+				if (newLatestGen >= gen)
+				{
+					lastQueuedGen = gen;
+					discardDelta();
+					state = UPDATE_FROM_GEN;
+					goto again; //sync();
+				}
+				
+				/* ahead of ZooKeeper: the snapshot is from before a reset, or from another cluster */
+				gen = -1;
+				coalescedGen = -1;
+			}
 	
 		case FIND_NEWEST_BLOB:
 		{
@@ -244,6 +691,9 @@ again:
 			assert(newLatestBlob > gen && newLatestBlob > latestBlob);
 			latestBlob = newLatestBlob;
 			
+			abortFetches();
+			queueFetch(NODE_BLOB, blobName(latestBlob), latestBlob);
+			
 			this->state = UPDATE_FROM_BLOB;
 			goto again; //sync();
 			break;
@@ -251,45 +701,92 @@ again:
 			
 		case UPDATE_FROM_BLOB:
 		{
-			int err = installBlob(latestBlob);
+			HugeNode *node = fetchQueue.front();
 			
-			if (err == ZOK)
-			{
-				int32_t newLatestGen = getInt32(root + LATEST_GEN, true);
-				
-				if (newLatestGen > latestGen)
-					latestGen = newLatestGen;
-				
-				state = UPDATE_FROM_GEN;
-				
-				if (latestGen > gen)
-					goto again; //sync();
-			}
-			else /* blob got deleted; look for a newer one */
+			if (node->err != ZOK) /* blob got deleted; look for a newer one */
 			{
 				this->state = FIND_NEWEST_BLOB;
 				goto again; //sync();
 			}
+			
+			if (!drain(node))
+			{
+				pumpFetches();
+				break;
+			}
+			
+			/* swap the staged copy in, so readers never see a half-installed ring */
+			dipMap->publish();
+			gen = node->tag;
+			fetchQueue.pop_front();
+			delete node;
+			
+			//click_chatter("New gen from blob: %d", (int)gen);
+			
+			int32_t newLatestGen = getInt32(root + LATEST_GEN, true);
+			
+			if (newLatestGen > latestGen)
+				latestGen = newLatestGen;
+			
+			lastQueuedGen = gen;
+			discardDelta();
+			state = UPDATE_FROM_GEN;
+			goto again; //sync();
 			break;
 		}
 			
 		case UPDATE_FROM_GEN:
 		{
-			while (gen < latestGen)
+			/* pipeline every generation we know about */
+			while (lastQueuedGen < latestGen)
 			{
-				int err = replayLog(gen + 1);
+				lastQueuedGen++;
+				queueFetch(NODE_LOG, logName(lastQueuedGen), lastQueuedGen);
+			}
+			
+			while (fetchQueue.size())
+			{
+				HugeNode *node = fetchQueue.front();
 				
-				if (err != ZOK)
+				if (node->err != ZOK)
 				{
+					discardDelta();
 					state = FIND_NEWEST_BLOB;
 					goto again; //sync();
+				}
+				
+				/* more generations behind this one: merge instead of applying */
+				if (node->consumed == 0)
+					node->coalesce = lastQueuedGen > node->tag;
+				
+				/* keep the order of writes */
+				if (!node->coalesce || delta.size() >= MAX_DELTA_SIZE)
+					flushDelta();
+				
+				if (!drain(node))
 					break;
+				
+				fetchQueue.pop_front();
+				
+				if (node->coalesce)
+				{
+					coalescedGen = node->tag;
+				}
+				else
+				{
+					gen++;
+					coalescedGen = gen;
 				}
 				
-				gen++;
+				delete node;
 				
 				//click_chatter("New gen from log: %d", (int)gen);
 			}
+			
+			if (!fetchQueue.size())
+				flushDelta();
+			
+			pumpFetches();
 			break;
 		}
 		}
@@ -298,11 +795,13 @@ again:
 	
 public:
 	ZKClient(String root, DIP_MAP *ring)
-		: root(root), dipMap(ring), gen(-1), zooHandle(NULL), state(INIT), latestGen(-1), latestBlob(-1), live(false)
+		: root(root), dipMap(ring), gen(-1), zooHandle(NULL), ownsHandle(false), state(INIT), latestGen(-1), latestBlob(-1), live(false),
+		  fetchWindow(DEFAULT_FETCH_WINDOW), inFlight(0), buffered(0), fetchEpoch(0), lastQueuedGen(-1),
+		  coalescedGen(-1), replayThreads(1), mapErrors(0)
 	{
 		zoo_set_debug_level(ZOO_LOG_LEVEL_ERROR);
-		dataBuf = new char[BUF_SIZE]; assert(dataBuf);
-		nodeBuf = new char[BUF_SIZE]; assert(nodeBuf);
+		inflateBuf = new char[INFLATE_BUF_SIZE]; assert(inflateBuf);
+		pthread_mutex_init(&updateLock, NULL);
 	}
 	
 	bool isLive() const
@@ -319,6 +818,39 @@ public:
 	{
 		return dipMap;
 	}
+	
+	/* keep the FSM from touching the map; gen and map stay consistent until unlocked */
+	void lockUpdates()
+	{
+		pthread_mutex_lock(&updateLock);
+	}
+	
+	void unlockUpdates()
+	{
+		pthread_mutex_unlock(&updateLock);
+	}
+	
+	/* the map was filled from a local snapshot at generation snapGen */
+	void warmStart(int32_t snapGen)
+	{
+		assert(state == INIT);
+		gen = snapGen;
+		coalescedGen = snapGen;
+	}
+	
+	/* max. chunk requests in flight, across the blob and upcoming generations */
+	void setFetchWindow(int window)
+	{
+		assert(window >= 1);
+		fetchWindow = window;
+	}
+	
+	/* threads used to apply a coalesced catch-up delta */
+	void setReplayThreads(int threads)
+	{
+		assert(threads >= 1);
+		replayThreads = threads;
+	}
 
 	int connect(const String &connectString)
 	{
@@ -326,10 +858,18 @@ public:
 		if (!zooHandle)
 			return -errno;
 		
+		ownsHandle = true;
 		live = true;
 		return 0;
 	}
 	
+	/* use a session that outlives this client */
+	void attach(zhandle_t *handle)
+	{
+		zooHandle = handle;
+		live = true;
+	}
+	
 	void sync()
 	{
 		String rootNode = root.substring(0, root.length() - 1);
@@ -337,6 +877,45 @@ public:
 		assert(err == ZOK);
 	}
 	
+	/*
+	 * Stop following ZooKeeper, before the session gets closed: closing
+	 * calls back whatever is pending, and those callbacks must find nothing
+	 * left to do.
+	 */
+	void stop()
+	{
+		pthread_mutex_lock(&updateLock);
+		live = false;
+		abortFetches();
+		pthread_mutex_unlock(&updateLock);
+	}
+	
+	/*
+	 * For nodes that come from the configuration. Returns -ENOENT if name
+	 * isn't there and -EIO if ZooKeeper can't be read (connection loss and
+	 * the like), rather than asserting like the FSM's reads.
+	 */
+	int readInt32(String name, int32_t *value)
+	{
+		int err;
+		int size = sizeof(int32_t);
+		int32_t ret;
+		
+		err = tryReadNode(name, false, reinterpret_cast<char *>(&ret), &size);
+		if (err == ZNONODE)
+			return -ENOENT;
+		if (err != ZOK)
+		{
+			click_chatter("zoo_wget: %d", err);
+			return -EIO;
+		}
+		if (size != sizeof(int32_t))
+			return -EINVAL;
+		
+		*value = ret;
+		return 0;
+	}
+	
 	int32_t getInt32(String name, bool watch)
 	{
 		int err;
@@ -353,11 +932,12 @@ public:
 
 	~ZKClient()
 	{
-		if (zooHandle)
+		stop();
+		if (zooHandle && ownsHandle)
 			zookeeper_close(zooHandle); //error code probably doesn't matter at this point
 		
-		delete dataBuf;
-		delete nodeBuf;
+		delete[] inflateBuf;
+		pthread_mutex_destroy(&updateLock);
 	}
 };
 
@@ -3,66 +3,88 @@
 #include <clicknet/tcp.h>
 #include <clicknet/udp.h>
 #include <click/error.hh>
-#include "../clickityclack/external/freebsdbob.hh"
+#include <click/handler.hh>
 #include "../clickityclack/lib/checksumfixup.hh"
 #include "lib/tcpopt.hh"
-#include "lib/p4crc32.hh"
+#include "lib/handlerargs.hh"
 
 CLICK_DECLS
 
 using namespace Beamer;
 using namespace ClickityClack;
 
-#define CLICK_BEAMER_HASHFN_BOB 0
-#define CLICK_BEAMER_HASHFN_CRC 1
-
-#ifndef CLICK_BEAMER_HASHFN
-#define CLICK_BEAMER_HASHFN CLICK_BEAMER_HASHFN_CRC
-#endif
-
-#define CLICK_BEAMER_STATEFUL_DAISY 0
-
-static inline uint32_t beamerHash(const click_ip *ipHeader, const click_tcp *tcpHeader)
+/* imported flows come as keys only */
+template <typename HASH>
+uint32_t StatefulMux::ringHash(uint64_t key)
 {
-#if CLICK_BEAMER_HASHFN == CLICK_BEAMER_HASHFN_BOB
-	return freeBSDBob(ipHeader->ip_src.s_addr, tcpHeader->th_sport, tcpHeader->th_dport);
-#elif CLICK_BEAMER_HASHFN == CLICK_BEAMER_HASHFN_CRC
-	struct HashTouple touple = { ipHeader->ip_src.s_addr, tcpHeader->th_sport };
-	return p4_crc32_6((char *)&touple);
-#else
-#error Invalid CLICK_BEAMER_HASHFN
-#endif
+	return HASH::hash(key >> 32, key >> 16, key);
 }
 
-static inline uint32_t beamerHash(const click_ip *ipHeader, const click_udp *udpHeader)
+StatefulMux::StatefulMux()
+	: rings(NULL), ring(NULL), adopting(false), flows(NULL), adoptingFlows(false), midstream(false), ringHashFunction(NULL), replicatePort(0), replicatePeerPort(0), rssRetaSize(0), transitionOnly(false), transitionWindow(0), stageFunction(NULL)
 {
-#if CLICK_BEAMER_HASHFN == CLICK_BEAMER_HASHFN_BOB
-	return freeBSDBob(ipHeader->ip_src.s_addr, udpHeader->uh_sport, udpHeader->uh_dport);
-#elif CLICK_BEAMER_HASHFN == CLICK_BEAMER_HASHFN_CRC
-	struct HashTouple touple = { ipHeader->ip_src.s_addr, udpHeader->uh_sport };
-	return p4_crc32_6((char *)&touple);
-#else
-#error Invalid CLICK_BEAMER_HASHFN
-#endif
 }
 
-StatefulMux::StatefulMux()
-	: hashZkClient("/beamer/mux_ring/", &bucketMap), idZkClient("/beamer/id/", &idMap) {}
-
-StatefulMux::~StatefulMux() {}
-
-static const int RESERVED_PORT_COUNT = 1024;
+StatefulMux::~StatefulMux()
+{
+	/* it's using the tables */
+	replicator.stop();
+	
+	if (flows)
+	{
+		for (int i = 0; i < tableCount(); i++)
+			delete flows[i];
+		delete[] flows;
+	}
+	delete rings;
+}
 
 int StatefulMux::configure(Vector<String> &conf, ErrorHandler *errh)
 {
 	String zkConnectString;
 	int ringSize = 1;
 	int maxStates = -1;
+	bool sharedStates = false;
+	uint32_t window = 5 * 60;
+	int replicatePortArg = 0;
+	int replicatePeerPortArg = 0;
+	uint32_t timeout = 4 * 60;
+	uint32_t halfOpenTimeout = 30;
+	uint32_t closingTimeout = 10;
+	int zkWindow = 16;
+	int zkReplayThreads = 1;
+	String hash = "CRC";
+	String reduce = "MODULO";
+	String encap = "IPIP";
+	int guePort = GUE_DEFAULT_PORT;
+	int retaSize = 128;
+	String snapshot;
+	String idSnapshot;
 	
 	if (Args(conf, this, errh)
-		.read("ZK",         StringArg(),                     zkConnectString)
-		.read("RING_SIZE",  BoundedIntArg(0, (int)0x800000), ringSize)
-		.read("MAX_STATES", IntArg(),                        maxStates)
+		.read("ZK",                  StringArg(),                       zkConnectString)
+		.read("RING_SIZE",           BoundedIntArg(0, (int)0x40000000), ringSize)
+		.read("MAX_STATES",          IntArg(),                          maxStates)
+		.read("SHARED_STATES",       BoolArg(),                         sharedStates)
+		.read("MIDSTREAM",           BoolArg(),                         midstream)
+		.read("TRANSITION_ONLY",     BoolArg(),                         transitionOnly)
+		.read("TRANSITION_WINDOW",   SecondsArg(),                      window)
+		.read("REPLICATE_PEER",      IPAddressArg(),                    replicatePeer)
+		.read("REPLICATE_PORT",      BoundedIntArg(1, 65535),           replicatePortArg)
+		.read("REPLICATE_PEER_PORT", BoundedIntArg(1, 65535),           replicatePeerPortArg)
+		.read("TIMEOUT",             SecondsArg(),                      timeout)
+		.read("HALF_OPEN_TIMEOUT",   SecondsArg(),                      halfOpenTimeout)
+		.read("CLOSING_TIMEOUT",     SecondsArg(),                      closingTimeout)
+		.read("HASH",                WordArg(),                         hash)
+		.read("REDUCE",              WordArg(),                         reduce)
+		.read("ENCAP",               WordArg(),                         encap)
+		.read("GUE_PORT",            BoundedIntArg(1, 65535),           guePort)
+		.read_all("RSS_CPU",         IntArg(),                          rssCPUs)
+		.read("RSS_RETA_SIZE",       IntArg(),                          retaSize)
+		.read("ZK_WINDOW",           BoundedIntArg(1, 1024),            zkWindow)
+		.read("ZK_REPLAY_THREADS",   BoundedIntArg(1, 64),              zkReplayThreads)
+		.read("SNAPSHOT",            FilenameArg(),                     snapshot)
+		.read("ID_SNAPSHOT",         FilenameArg(),                     idSnapshot)
 		.complete() < 0)
 	{
 		return -1;
@@ -71,211 +93,423 @@ int StatefulMux::configure(Vector<String> &conf, ErrorHandler *errh)
 	if (maxStates <= 0)
 		return errh->error("Bad MAX_STATES");
 
-	if (zkConnectString.length() != 0)
+	flowTimeouts.established = timeout * CLICK_HZ;
+	flowTimeouts.halfOpen = halfOpenTimeout * CLICK_HZ;
+	flowTimeouts.closing = closingTimeout * CLICK_HZ;
+	if (timeout == 0 || FlowTable::ticks(flowTimeouts.established) > FlowTable::MAX_TIMEOUT)
+		return errh->error("Bad TIMEOUT");
+	if (halfOpenTimeout == 0 || FlowTable::ticks(flowTimeouts.halfOpen) > FlowTable::MAX_TIMEOUT)
+		return errh->error("Bad HALF_OPEN_TIMEOUT");
+	if (closingTimeout == 0 || FlowTable::ticks(flowTimeouts.closing) > FlowTable::MAX_TIMEOUT)
+		return errh->error("Bad CLOSING_TIMEOUT");
+	if (window == 0 || window > 0x7fffffff)
+		return errh->error("Bad TRANSITION_WINDOW");
+	transitionWindow = window;
+	if (replicatePeer && !replicatePortArg)
+		return errh->error("REPLICATE_PEER needs REPLICATE_PORT");
+	replicatePort = replicatePortArg;
+	replicatePeerPort = replicatePeerPortArg ? replicatePeerPortArg : replicatePortArg;
+	if (!parseHashKind(hash, &policies.hash))
+		return errh->error("Bad HASH: expected CRC, BOB or TOEPLITZ");
+	if (!parseReductionKind(reduce, &policies.reduction))
+		return errh->error("Bad REDUCE: expected MODULO, MASK or MULTIPLY_SHIFT");
+	if (!parseEncapKind(encap, &policies.encap))
+		return errh->error("Bad ENCAP: expected IPIP, GG or GUE");
+	encapper.setGUEPort(guePort);
+	
+	/* connections from before a bucket's change are never in the table: only daisy chaining keeps them */
+	if (transitionOnly && !encapCarriesMetadata(policies.encap))
+		return errh->error("TRANSITION_ONLY needs ENCAP GG or GUE");
+	
+	/* daisy chaining comes with any ENCAP that carries metadata */
+	if (transitionOnly)
+		stageFunction = pickPolicies<StagePicker<TransitionState> >(policies);
+	else
+		stageFunction = pickPolicies<StagePicker<FullState> >(policies);
+	
+	switch (policies.hash)
+	{
+	case HASH_BOB:
+		ringHashFunction = ringHash<BOBHash>;
+		break;
+	case HASH_TOEPLITZ:
+		ringHashFunction = ringHash<ToeplitzHash>;
+		break;
+	default:
+		ringHashFunction = ringHash<CRCHash>;
+		break;
+	}
+	
+	int sliceBits = rssSliceBits(policies, rssCPUs, retaSize, errh);
+	if (sliceBits < 0)
+		return -1;
+	rssRetaSize = retaSize;
+	
+	/* per-CPU tables only hold their own CPU's flows: the peer's need to be told apart */
+	if (replicatePeer && !sharedStates && !rssCPUs.size())
+		return errh->error("REPLICATE_PEER needs SHARED_STATES or RSS_CPU");
+	
+	Vector<String> services;
+	Vector<IPAddress> vips;
+	
+	rings = new RingTable(RingTable::describe(zkConnectString, services, vips, ringSize)); assert(rings);
+	rings->setFetchWindow(zkWindow);
+	rings->setReplayThreads(zkReplayThreads);
+	if (sliceBits)
+		rings->setSlicing(sliceBits, rssCPUs);
+	
+	StatefulMux *old = (StatefulMux *)(hotswap_element() ? hotswap_element()->cast("StatefulMux") : NULL);
+	
+	/* no point in connecting and downloading what the old instance already has */
+	adopting = old && old->rings && old->rings->getSpec() == rings->getSpec();
+	if (!adopting)
 	{
-		if (hashZkClient.connect(zkConnectString) < 0)
-			return errh->error("Error connectiong to ZooKeeper: %s", strerror(errno));
-		if (idZkClient.connect(zkConnectString) < 0)
-			return errh->error("Error connectiong to ZooKeeper: %s", strerror(errno));
-		vip = hashZkClient.getInt32("/beamer/config/vip", false);
-		bucketMap.init(hashZkClient.getInt32("/beamer/config/ring_size", false));
+		if (rings->setUp(zkConnectString, services, vips, ringSize, errh) < 0)
+			return -1;
+		ring = rings->get(0);
+		
+		ring->loadSnapshots(snapshot, idSnapshot, errh);
+	}
+	
+	/* the ring comes with its size; the old instance's if we're taking it over */
+	RingState *sized = adopting ? old->ring : ring;
+	
+	if (!reductionFits(policies.reduction, sized->bucketMap.size()))
+		return errh->error("REDUCE %s doesn't fit ring size %lu", reduce.c_str(), sized->bucketMap.size());
+	if (sliceBits && sized->bucketMap.slices() != (1UL << sliceBits))
+		return errh->error("RSS_RETA_SIZE %d needs a ring of at least that many buckets", retaSize);
+	
+	uint32_t capacity = FlowTable::roundCapacity(sharedStates ? maxStates : maxStates / click_max_cpu_ids());
+	
+	/* the old tables are going to be taken over as they are: don't make new ones just to throw them away */
+	adoptingFlows = old && canAdopt(old, sharedStates, capacity, replicatePeer);
+	if (adoptingFlows)
+		return 0;
+	
+	flows = new FlowTable *[click_max_cpu_ids()]; assert(flows);
+	if (sharedStates)
+	{
+		/* flows may hop cores: one table that every CPU uses */
+		flows[0] = new FlowTable(maxStates, flowTimeouts, true); assert(flows[0]);
+		for (int i = 1; i < click_max_cpu_ids(); i++)
+			flows[i] = flows[0];
 	}
 	else
 	{
-		vip = 0;
-		bucketMap.init(ringSize);
+		for (int i = 0; i < click_max_cpu_ids(); i++)
+		{
+			flows[i] = new FlowTable(maxStates / click_max_cpu_ids(), flowTimeouts); assert(flows[i]);
+		}
 	}
 	
-	idMap.init(0x10000);
-	
-	states = new StateTrack<MuxState>*[click_max_cpu_ids()]; assert(states);
+	/* by default only SYNs make state; anything else that misses just follows the ring */
 	for (int i = 0; i < click_max_cpu_ids(); i++)
+		flows[i]->setMidstream(midstream);
+	
+	if (replicatePeer)
 	{
-		states[i] = new StateTrack<MuxState>(4 * 60 * CLICK_HZ, maxStates / click_max_cpu_ids()); assert(states[i]);
+		for (int i = 0; i < tableCount(); i++)
+			flows[i]->setJournal(true);
 	}
 	
+	setUpRouter();
+	
 	return 0;
 }
 
+/* a shared table gets everything; per-CPU ones what RSS sends their CPU */
+void StatefulMux::setUpRouter()
+{
+	Vector<FlowTable *> routes;
+	
+	if (flows[0]->isShared())
+		routes.push_back(flows[0]);
+	else if (rssCPUs.size())
+	{
+		/* ethtool's "equal" spreads indirection table entries over queues round robin */
+		for (int i = 0; i < rssRetaSize; i++)
+			routes.push_back(flows[rssCPUs[i % rssCPUs.size()]]);
+	}
+	
+	router.set(routes, ringHashFunction);
+}
+
 int StatefulMux::initialize(ErrorHandler *errh)
 {
-	(void)errh;
+	if (!adopting)
+		rings->sync();
+	
+	/* a StatefulMux we're hotswapping from may still hold the port; take_state() starts it then */
+	if (!hotswap_element() || !hotswap_element()->cast("StatefulMux"))
+		return startReplicator(errh);
+	
+	return 0;
+}
+
+int StatefulMux::startReplicator(ErrorHandler *errh)
+{
+	if (!replicatePeer)
+		return 0;
 	
-	if (hashZkClient.isLive())
-		hashZkClient.sync();
+	Vector<FlowTable *> tables;
 	
-	if (idZkClient.isLive())
-		idZkClient.sync();
+	for (int i = 0; i < tableCount(); i++)
+		tables.push_back(flows[i]);
+	
+	int err = replicator.start(tables, &router, replicatePort, replicatePeer, replicatePeerPort);
+	if (err < 0)
+		return errh->error("Error starting flow replication: %s", strerror(-err));
 	
 	return 0;
 }
 
-Packet *StatefulMux::handleTCP(Packet *p, unsigned int cpuID, click_jiffies_t now)
+bool StatefulMux::canAdopt(const StatefulMux *other, bool shared, uint32_t capacity, bool journaling) const
 {
-	const click_ip *ipHeader = p->ip_header();
-	const click_tcp *tcpHeader = p->tcp_header();
-	uint32_t dip;
-#if CLICK_BEAMER_STATEFUL_DAISY
-	uint32_t prevDip = 0;
-	uint32_t ts;
-	uint32_t gen = htonl(hashZkClient.getGen());
-#endif
+	/* flows sit in the tables by their ring hash */
+	return other->flows &&
+		other->policies.hash == policies.hash &&
+		other->flows[0]->isShared() == shared &&
+		other->flows[0]->capacity() == capacity &&
+		other->flows[0]->journaling() == journaling;
+}
+
+void StatefulMux::take_state(Element *old, ErrorHandler *errh)
+{
+	StatefulMux *oldMux = (StatefulMux *)old->cast("StatefulMux");
 	
-	if (ntohs(tcpHeader->th_dport) < RESERVED_PORT_COUNT)
+	if (!oldMux)
+		return;
+	
+	if (adopting)
 	{
-		uint32_t hash = beamerHash(ipHeader, tcpHeader);
-		DIPHistoryEntry entry = bucketMap.get(hash);
-		MuxState *state = states[cpuID]->getBestEffort(FiveTuple(ipHeader, tcpHeader), now);
+		/* the new settings apply to the adopted clients from here on */
+		oldMux->rings->retune(rings);
 		
-		if (state)
-		{
-			states[cpuID]->refresh(state, now);
-			dip = state->dip;
-#if CLICK_BEAMER_STATEFUL_DAISY
-			if (dip == entry.current)
-			{
-				prevDip = entry.prev;
-				ts = entry.timestamp;
-			}
-#endif
-		}
-		else
+		RingTable *tmp = rings;
+		rings = oldMux->rings;
+		oldMux->rings = tmp;
+		ring = rings->get(0);
+		oldMux->ring = NULL;
+	}
+	
+	/* it's using the old tables and the port */
+	oldMux->replicator.stop();
+	
+	if (adoptingFlows)
+	{
+		flows = oldMux->flows;
+		oldMux->flows = NULL;
+		
+		/* the new settings apply to the old flows from here on */
+		for (int i = 0; i < tableCount(); i++)
 		{
-			dip = entry.current;
-#if CLICK_BEAMER_STATEFUL_DAISY
-			prevDip = entry.prev;
-			ts = entry.timestamp;
-#endif
-			
-			state = states[cpuID]->allocate();
-			state = new(state) MuxState(FiveTuple(ipHeader, tcpHeader), dip);
-			states[cpuID]->putBestEffort(state, now);
+			flows[i]->setTimeouts(flowTimeouts);
+			flows[i]->setMidstream(midstream);
 		}
+		setUpRouter();
 	}
-	else
+	else if (oldMux->flows)
 	{
-		uint16_t id = ntohs(tcpHeader->th_dport);
-		dip = idMap.get(id);
+		/* different layout: move the flows over one by one, if we can tell where they go */
+		Vector<FlowRecord> records;
+		uint32_t now = FlowTable::ticks(click_jiffies());
+		
+		if (router.isSet())
+		{
+			for (int i = 0; i < oldMux->tableCount(); i++)
+				oldMux->flows[i]->snapshot(&records, now);
+			importFlows(records.begin(), records.size());
+		}
+		else if (!oldMux->flows[0]->isShared())
+		{
+			/* per-CPU both: flows stay with their CPU */
+			for (int i = 0; i < tableCount(); i++)
+			{
+				Vector<FlowTable *> route;
+				
+				route.push_back(flows[i]);
+				records.clear();
+				oldMux->flows[i]->snapshot(&records, now);
+				FlowRouter(route, ringHashFunction).import(records.begin(), records.size());
+			}
+		}
 	}
-
-#if CLICK_BEAMER_STATEFUL_DAISY	
-	if (!prevDip || prevDip == dip)
-#endif
-		return ipipEncapper.encapsulate(p, vip.addr(), dip);
-
-#if CLICK_BEAMER_STATEFUL_DAISY	
-	return ggEncapper.encapsulate(p, vip.addr(), dip, prevDip, ts, gen);
-#endif
-}
-
-Packet *StatefulMux::handleUDP(Packet *p)
-{
-	uint32_t hash = beamerHash(p->ip_header(), p->udp_header());
-	uint32_t dip = bucketMap.get(hash).current;
 	
-	return ipipEncapper.encapsulate(p, vip.addr(), dip);
+	startReplicator(errh);
 }
 
-#if HAVE_BATCH
-PacketBatch *StatefulMux::simple_action_batch(PacketBatch *head)
+/*
+ * Like BeamerMux, every stage gets split by class once (see
+ * classifyStage()); ring TCP is the flows. Each class then has loops of
+ * its own; packets are updated in place.
+ */
+template <typename STATE, typename HASH, typename REDUCTION, typename ENCAP>
+void StatefulMux::processStage(Packet **pkts, int count, unsigned int cpuID, uint32_t now, uint32_t wallNow)
 {
-	Packet *current = head;
-	Packet *last = head;
-	unsigned int cpuID = click_current_cpu_id();
-	click_jiffies_t now = click_jiffies();
+	StageClasses classes;
+	HashTouple touples[BATCH_STAGE];
+	uint16_t dports[BATCH_STAGE];
+	uint32_t hashes[BATCH_STAGE];
+	unsigned long buckets[BATCH_STAGE];
+	DIPHistoryEntry entries[BATCH_STAGE];
+	uint64_t flowKeys[BATCH_STAGE];
+	uint32_t flowHashes[BATCH_STAGE];
+	uint32_t flowDips[BATCH_STAGE];
+	uint8_t flowEvents[BATCH_STAGE];
+	int8_t trackSlots[BATCH_STAGE];
+	int trackCount = 0;
+	uint16_t ids[BATCH_STAGE];
+	uint32_t idHashes[BATCH_STAGE];
+	RingMap::View ringView = ring->bucketMap.view();
+	PlainDIPMap::View idView = ring->idMap.view();
+	FlowTable *flowTable = flows[cpuID];
+	uint32_t vip = ring->vip.addr();
+	uint32_t gen = ENCAP::METADATA ? htonl(ring->hashZkClient.getGen()) : 0;
 	
-	while (current != NULL)
+	/* stage 1: split by class */
+	classifyStage(pkts, count, NULL, &classes);
+	
+	const uint8_t *ringPkts = classes.ringPkts;
+	const uint8_t *idPkts = classes.idPkts;
+	int tcpCount = classes.tcpCount;
+	int idCount = classes.idCount;
+	int ringCount = classes.ringCount();
+	
+	/* stage 2: hash and prefetch, so that the map and flow table misses overlap */
+	for (int j = 0; j < ringCount; j++)
 	{
-		/* do stuff */
-		uint8_t proto = current->ip_header()->ip_p;
-		Packet *result = NULL;
+		const click_ip *ipHeader = pkts[ringPkts[j]]->ip_header();
+		const uint16_t *ports = reinterpret_cast<const uint16_t *>(pkts[ringPkts[j]]->transport_header());
 		
-		switch (proto)
-		{
-		case IPPROTO_TCP:
-			result = handleTCP(current, cpuID, now);
-			break;
-			
-		case IPPROTO_UDP:
-			result = handleUDP(current);
-			break;
-			
-		default:
-			result = current;
-			break;
-		}
+		touples[j].src_ip = ipHeader->ip_src.s_addr;
+		touples[j].src_port = ports[0];
+		dports[j] = ports[1];
+	}
+	for (int j = 0; j < tcpCount; j++)
+	{
+		const click_tcp *tcpHeader = pkts[ringPkts[j]]->tcp_header();
 		
-		if (current == head)
-		{
-			head = PacketBatch::start_head(result);
-			head->set_next(current->next());
-		}
+		flowKeys[j] = FlowTable::key(touples[j].src_ip, touples[j].src_port, dports[j]);
+		flowEvents[j] = FlowTable::event(tcpHeader);
+	}
+	HASH::hashBatch(touples, dports, hashes, ringCount);
+	for (int j = 0; j < ringCount; j++)
+	{
+		buckets[j] = REDUCTION::bucket(hashes[j], ring->bucketMap.size());
+		ring->bucketMap.prefetchAt(ringView, buckets[j]);
+	}
+	for (int j = 0; j < tcpCount; j++)
+	{
+		flowHashes[j] = FlowTable::hash(hashes[j], dports[j]);
+		if (STATE::PREFETCH)
+			flowTable->prefetch(flowHashes[j]);
+	}
+	for (int k = 0; k < idCount; k++)
+	{
+		const click_tcp *tcpHeader = pkts[idPkts[k]]->tcp_header();
+		
+		ids[k] = ntohs(tcpHeader->th_dport);
+		idHashes[k] = Encapper::entropy(pkts[idPkts[k]]->ip_header()->ip_src.s_addr, tcpHeader->th_sport);
+		ring->idMap.prefetch(idView, ids[k]);
+	}
+	
+	/*
+	 * stage 3: offer the ring's choice to new flows, then look them all up
+	 * at once; flows that are tracked get packed to the front
+	 */
+	for (int j = 0; j < ringCount; j++)
+		entries[j] = ring->bucketMap.at(ringView, buckets[j]);
+	for (int j = 0; j < tcpCount; j++)
+	{
+		bool tracked = STATE::tracks(entries[j], wallNow, transitionWindow);
+		
+		/* trackCount never passes j, so this packs in place */
+		trackSlots[j] = tracked ? trackCount : -1;
+		flowKeys[trackCount] = flowKeys[j];
+		flowHashes[trackCount] = flowHashes[j];
+		flowEvents[trackCount] = flowEvents[j];
+		flowDips[trackCount] = entries[j].current;
+		trackCount += tracked;
+	}
+	flowTable->lookupInsertBatch(flowKeys, flowHashes, flowDips, flowEvents, trackCount, now, cpuID);
+	
+	/* stage 4: encapsulate, a class at a time */
+	for (int j = 0; j < tcpCount; j++)
+	{
+		int i = ringPkts[j];
+		DIPHistoryEntry *entry = &entries[j];
+		uint32_t dip = trackSlots[j] >= 0 ? flowDips[trackSlots[j]] : entry->current;
+		
+		/* flows that follow the ring may still have connections to daisy chain to */
+		if (ENCAP::METADATA && dip == entry->current && entry->prev && entry->prev != entry->current)
+			pkts[i] = ENCAP::encapsulate(&encapper, pkts[i], vip, entry->current, entry->prev, entry->timestamp, gen, hashes[j]);
 		else
-		{
-			last->set_next(result);
-			result->set_next(current->next());
-		}
+			pkts[i] = ENCAP::encapsulatePlain(&encapper, pkts[i], vip, dip, hashes[j]);
+	}
+	for (int j = tcpCount; j < ringCount; j++)
+	{
+		int i = ringPkts[j];
+		
+		pkts[i] = ENCAP::encapsulatePlain(&encapper, pkts[i], vip, entries[j].current, hashes[j]);
+	}
+	for (int k = 0; k < idCount; k++)
+	{
+		int i = idPkts[k];
 		
-		last = result;
-		current = result->next();
+		pkts[i] = ENCAP::encapsulatePlain(&encapper, pkts[i], vip, ring->idMap.get(idView, ids[k]), idHashes[k]);
 	}
+}
+
+#if HAVE_BATCH
+PacketBatch *StatefulMux::simple_action_batch(PacketBatch *head)
+{
+	unsigned int cpuID = click_current_cpu_id();
+	uint32_t now = FlowTable::ticks(click_jiffies());
+	StageCall call = { this, stageFunction, cpuID, now, transitionOnly ? (uint32_t)time(NULL) : 0 };
+	
+	/* a few buckets' worth of expiry per batch */
+	flows[cpuID]->expire(now, cpuID);
+	
+	/* no view outlives the batch */
+	rings->readers()->enter(cpuID);
+	head = runStages(head, call);
+	rings->readers()->exit(cpuID);
+	
 	return head;
 }
 #endif
 
 Packet *StatefulMux::simple_action(Packet *p)
 {
-	uint8_t proto = p->ip_header()->ip_p;
 	unsigned int cpuID = click_current_cpu_id();
-	click_jiffies_t now = click_jiffies();
+	uint32_t now = FlowTable::ticks(click_jiffies());
 	
-	switch (proto)
-	{
-	case IPPROTO_TCP:
-		return handleTCP(p, cpuID, now);
-		
-	case IPPROTO_UDP:
-		return handleUDP(p);
-		
-	default:
-		return p;
-	}
+	flows[cpuID]->expire(now, cpuID);
+	
+	/* a stage of one */
+	rings->readers()->enter(cpuID);
+	(this->*stageFunction)(&p, 1, cpuID, now, transitionOnly ? time(NULL) : 0);
+	rings->readers()->exit(cpuID);
 	
-	p->kill();
-	return NULL;
+	return p;
 }
 
 enum
 {
 	/* write */
 	H_ASSIGN,
+	H_IMPORT_FLOWS,
 	
 	/* read */
 	H_GEN,
+	H_EXPIRED,
+	H_EVICTED,
+	H_REFUSED,
+	H_FLOWS,
+	H_REPLICATION,
+	H_RSS,
 };
 
-static void tokenize(const String &str, int startIndex, Vector<String> *vec)
-{
-	if (startIndex == str.length())
-		return;
-	
-	int spaceIndex = str.find_left(' ', startIndex);
-	
-	if (spaceIndex == -1) /* no spaces */
-	{
-		vec->push_back(str.substring(startIndex, str.length() - startIndex));
-	}
-	else if (spaceIndex == startIndex) /* starts with space */
-	{
-		tokenize(str, startIndex + 1, vec);
-	}
-	else /* got some space */
-	{
-		vec->push_back(str.substring(startIndex, spaceIndex - startIndex));
-		tokenize(str, spaceIndex + 1, vec);
-	}
-}
-
 int StatefulMux::writeHandler(const String &conf, Element *e, void *thunk, ErrorHandler *errh)
 {
 	StatefulMux *me = (StatefulMux *)e;
@@ -284,33 +518,37 @@ int StatefulMux::writeHandler(const String &conf, Element *e, void *thunk, Error
 	IPAddress dip;
 	Vector<String> tokens;
 	
-	DIPHistoryLogHeader ts;
+	int err;
 	
 	switch ((intptr_t)thunk)
 	{
 	case H_ASSIGN:
 		tokenize(conf, 0, &tokens);
-		if (tokens.size() < 2)
-			return errh->error("expected 2+ arguments, got %d", tokens.size());
+		if (parseAssignment(tokens, 0, me->ring->bucketMap.size(), &dip, &buckets, errh) < 0)
+			return -1;
+		if ((err = me->ring->assign(dip.addr(), buckets)) < 0)
+			return errh->error("%s", strerror(-err));
+		break;
+	
+	case H_IMPORT_FLOWS:
+	{
+		FlowTable::SnapshotHeader header;
 		
-		if (!IPAddressArg().parse(tokens[0], dip))
-			return errh->error("bad DIP");
+		if (conf.length() < (int)sizeof(header))
+			return errh->error("truncated flow snapshot");
+		memcpy(&header, conf.data(), sizeof(header));
 		
-		for (int i = 1; i < tokens.size(); i++)
-		{
-			int index;
-			
-			if (!IntArg().parse(tokens[i], index))
-				return errh->error("bad index %s", tokens[i].c_str());
-			buckets.push_back(index);
-		}
-		
-		ts.timestamp = time(NULL);
-		for (int i = 0; i < buckets.size(); i++)
-			me->bucketMap.updateEntry(buckets[i], dip.addr(), ts);
+		if (header.magic != FlowTable::SNAPSHOT_MAGIC || header.version != FlowTable::SNAPSHOT_VERSION || header.recordSize != sizeof(FlowRecord))
+			return errh->error("bad flow snapshot header");
+		if ((uint64_t)conf.length() != sizeof(header) + (uint64_t)header.count * sizeof(FlowRecord))
+			return errh->error("bad flow snapshot size");
+		if (!me->router.isSet())
+			return errh->error("importing flows needs SHARED_STATES or RSS_CPU");
 		
+		me->importFlows((const FlowRecord *)(conf.data() + sizeof(header)), header.count);
 		break;
-		
+	}
+	
 	default:
 		return errh->error("bad operation");
 	}
@@ -318,6 +556,12 @@ int StatefulMux::writeHandler(const String &conf, Element *e, void *thunk, Error
 	return 0;
 }
 
+/* each flow goes to the one table that's going to see it */
+void StatefulMux::importFlows(const FlowRecord *records, int count)
+{
+	router.import(records, count);
+}
+
 String StatefulMux::readHandler(Element *e, void *thunk)
 {
 	StatefulMux *me = (StatefulMux *)e;
@@ -325,8 +569,67 @@ String StatefulMux::readHandler(Element *e, void *thunk)
 	switch ((intptr_t)thunk)
 	{
 	case H_GEN:
-		return String() + me->hashZkClient.getGen();
+		return String() + me->ring->hashZkClient.getGen();
+	
+	case H_EXPIRED:
+	case H_EVICTED:
+	case H_REFUSED:
+	{
+		uint64_t total = 0;
+		
+		for (int i = 0; i < me->tableCount(); i++)
+		{
+			if ((intptr_t)thunk == H_EXPIRED)
+				total += me->flows[i]->expired();
+			else if ((intptr_t)thunk == H_EVICTED)
+				total += me->flows[i]->evicted();
+			else
+				total += me->flows[i]->refused();
+		}
+		return String(total);
+	}
+	
+	case H_FLOWS:
+	{
+		Vector<FlowRecord> records;
+		uint32_t now = FlowTable::ticks(click_jiffies());
+		FlowTable::SnapshotHeader header;
+		
+		for (int i = 0; i < me->tableCount(); i++)
+			me->flows[i]->snapshot(&records, now);
 		
+		header.magic = FlowTable::SNAPSHOT_MAGIC;
+		header.version = FlowTable::SNAPSHOT_VERSION;
+		header.recordSize = sizeof(FlowRecord);
+		header.count = records.size();
+		
+		String ret((const char *)&header, sizeof(header));
+		ret.append((const char *)records.begin(), records.size() * sizeof(FlowRecord));
+		return ret;
+	}
+	
+	case H_REPLICATION:
+	{
+		uint64_t dropped = 0;
+		uint64_t overflowed = 0;
+		
+		for (int i = 0; i < me->tableCount(); i++)
+		{
+			dropped += me->flows[i]->journalDropped();
+			overflowed += me->flows[i]->importDropped();
+		}
+		
+		return String("sent ") + me->replicator.getSent() +
+			" received " + me->replicator.getReceived() +
+			" rejected " + me->replicator.getRejected() +
+			" dropped " + dropped +
+			" overflowed " + overflowed;
+	}
+	
+	/* for ethtool -X */
+	case H_RSS:
+		return me->rssCPUs.size() ? toeplitzRSSSettings(me->rssCPUs.size()) : String();
+	
 	default:
 		return "<error: bad operation>";
 	}
@@ -337,8 +640,15 @@ String StatefulMux::readHandler(Element *e, void *thunk)
 void StatefulMux::add_handlers()
 {
 	add_write_handler("assign", &writeHandler, H_ASSIGN);
+	add_write_handler("flows", &writeHandler, H_IMPORT_FLOWS, Handler::f_raw);
 	
 	add_read_handler("gen", &readHandler, H_GEN);
+	add_read_handler("expired", &readHandler, H_EXPIRED);
+	add_read_handler("evicted", &readHandler, H_EVICTED);
+	add_read_handler("refused", &readHandler, H_REFUSED);
+	add_read_handler("flows", &readHandler, H_FLOWS, Handler::f_raw);
+	add_read_handler("replication", &readHandler, H_REPLICATION);
+	add_read_handler("rss", &readHandler, H_RSS);
 }
 
 CLICK_ENDDECLS
@@ -347,5 +657,9 @@ EXPORT_ELEMENT(StatefulMux)
 
 ELEMENT_REQUIRES(Beamer_ZKClient)
 ELEMENT_REQUIRES(Beamer_TCPOpt)
-ELEMENT_REQUIRES(ClickityClack_IPIPEncapper)
 ELEMENT_REQUIRES(Beamer_GGEncapper)
+ELEMENT_REQUIRES(Beamer_GUEEncapper)
+ELEMENT_REQUIRES(Beamer_P4CRC32)
+ELEMENT_REQUIRES(Beamer_Toeplitz)
+ELEMENT_REQUIRES(Beamer_FlowTable)
+ELEMENT_REQUIRES(Beamer_FlowReplicator)
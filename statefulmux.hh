@@ -7,12 +7,11 @@
 #if HAVE_BATCH
 #include <click/batchelement.hh>
 #endif
-#include "lib/dipmap.hh"
-#include "lib/zkclient.hh"
-#include "lib/ggencapper.hh"
-#include "../clickityclack/lib/ipipencapper.hh"
-#include "../clickityclack/lib/statetrack.hh"
-#include "../clickityclack/lib/fivetuple.hh"
+#include "lib/ringtable.hh"
+#include "lib/muxpolicy.hh"
+#include "lib/flowtable.hh"
+#include "lib/flowreplicator.hh"
+#include "lib/batchstage.hh"
 
 CLICK_DECLS
 
@@ -37,6 +36,8 @@ public:
 	
 	int initialize(ErrorHandler *errh);
 	
+	void take_state(Element *old, ErrorHandler *errh);
+	
 	Packet *simple_action(Packet *p);
 	
 #if HAVE_BATCH
@@ -50,31 +51,128 @@ public:
 	void add_handlers();
 	
 private:
-	ClickityClack::IPIPEncapper ipipEncapper;
-	Beamer::GGEncapper ggEncapper;
+	Beamer::Encapper encapper;
+	
+	Beamer::MuxPolicies policies;
+	
+	/* a single VIP's; ring is its only entry */
+	Beamer::RingTable *rings;
+	Beamer::RingState *ring;
+	
+	/* the old instance's ring and session get taken over in take_state() */
+	bool adopting;
+	
+	/* one per CPU */
+	Beamer::FlowTable **flows;
+	
+	/* the old instance's tables get taken over in take_state(); flows stays NULL till then */
+	bool adoptingFlows;
+	
+	/* for the tables we take over */
+	Beamer::FlowTable::Timeouts flowTimeouts;
+	bool midstream;
+	
+	/* whether tables laid out like this can take the place of another instance's as they are */
+	bool canAdopt(const StatefulMux *other, bool shared, uint32_t capacity, bool journaling) const;
+	
+	/* distinct tables in flows */
+	int tableCount() const
+	{
+		return flows[0]->isShared() ? 1 : click_max_cpu_ids();
+	}
+	
+	template <typename HASH>
+	static uint32_t ringHash(uint64_t key);
+	
+	/* ringHash() for the configured hash */
+	Beamer::FlowRouter::HashFunction ringHashFunction;
+	
+	/* where imported and replicated flows go; unset if there's no telling */
+	Beamer::FlowRouter router;
+	
+	void setUpRouter();
 	
-	IPAddress vip;
+	void importFlows(const Beamer::FlowRecord *records, int count);
 	
-	Beamer::DIPHistoryMap bucketMap;
-	Beamer::ZKClient<Beamer::DIPHistoryMap> hashZkClient;
+	int startReplicator(ErrorHandler *errh);
 	
-	Beamer::PlainDIPMap idMap;
-	Beamer::ZKClient<Beamer::PlainDIPMap> idZkClient;
+	/* flows to and from a peer mux */
+	Beamer::FlowReplicator replicator;
+	IPAddress replicatePeer;
+	uint16_t replicatePort;
+	uint16_t replicatePeerPort;
 	
-	struct MuxState: public ClickityClack::State<ClickityClack::FiveTuple>
+	/* the CPU serving each queue RSS spreads over with our key; empty without RSS */
+	Vector<int> rssCPUs;
+	int rssRetaSize;
+	
+	/*
+	 * Only track flows in buckets that changed DIPs less than
+	 * transitionWindow seconds ago. Connections opened before the change
+	 * are never tracked; they rely on the backends daisy chaining them
+	 * back, so this needs an ENCAP that carries metadata (GG or GUE).
+	 */
+	bool transitionOnly;
+	uint32_t transitionWindow;
+	
+	/* state policies: which flows get tracked */
+	struct FullState
 	{
-		uint32_t dip;
+		/* most lookups are going to happen */
+		static const bool PREFETCH = true;
 		
-		MuxState();
+		static bool tracks(const Beamer::DIPHistoryEntry &entry, uint32_t wallNow, uint32_t window)
+		{
+			(void)entry; (void)wallNow; (void)window;
+			return true;
+		}
+	};
+	
+	/* the ring is right for every flow of a settled bucket */
+	struct TransitionState
+	{
+		static const bool PREFETCH = false;
 		
-		MuxState(ClickityClack::FiveTuple tuple, uint32_t dip)
-			: ClickityClack::State<ClickityClack::FiveTuple>(tuple), dip(dip) {}
+		static bool tracks(const Beamer::DIPHistoryEntry &entry, uint32_t wallNow, uint32_t window)
+		{
+			return entry.inTransition(wallNow, window);
+		}
 	};
 	
-	ClickityClack::StateTrack<MuxState> **states;
+	template <typename STATE, typename HASH, typename REDUCTION, typename ENCAP>
+	void processStage(Packet **pkts, int count, unsigned int cpuID, uint32_t now, uint32_t wallNow);
+	
+	typedef void (StatefulMux::*StageFunction)(Packet **pkts, int count, unsigned int cpuID, uint32_t now, uint32_t wallNow);
+	
+	/* processStage() for the configured policies */
+	StageFunction stageFunction;
 	
-	Packet *handleTCP(Packet *p, unsigned int cpuID, click_jiffies_t now);
-	Packet *handleUDP(Packet *p);
+	/* a stage, as runStages() calls it */
+	struct StageCall
+	{
+		StatefulMux *mux;
+		StageFunction function;
+		unsigned int cpuID;
+		uint32_t now;
+		uint32_t wallNow;
+		
+		void operator()(Packet **pkts, int count) const
+		{
+			(mux->*function)(pkts, count, cpuID, now, wallNow);
+		}
+	};
+	
+	template <typename STATE>
+	struct StagePicker
+	{
+		typedef StageFunction Result;
+		
+		template <typename HASH, typename REDUCTION, typename ENCAP>
+		static Result pick()
+		{
+			return &StatefulMux::processStage<STATE, HASH, REDUCTION, ENCAP>;
+		}
+	};
 };
 
 CLICK_ENDDECLS